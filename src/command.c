@@ -26,6 +26,7 @@
 #include "exception.h"
 #include "command.h"
 #include "gdb_packet.h"
+#include "gdb_main.h"
 #include "target.h"
 #include "morse.h"
 #include "version.h"
@@ -33,6 +34,9 @@
 #ifdef PLATFORM_HAS_TRACESWO
 #	include "traceswo.h"
 #endif
+#ifdef PLATFORM_HAS_RTT
+#	include "rtt.h"
+#endif
 
 typedef bool (*cmd_handler)(target *t, int argc, const char **argv);
 
@@ -53,12 +57,17 @@ static bool cmd_morse(target *t, int argc, char **argv);
 static bool cmd_halt_timeout(target *t, int argc, const char **argv);
 static bool cmd_connect_srst(target *t, int argc, const char **argv);
 static bool cmd_hard_srst(target *t, int argc, const char **argv);
+static bool cmd_flash_incremental(target *t, int argc, const char **argv);
+static bool cmd_halt_poll(target *t, int argc, const char **argv);
 #ifdef PLATFORM_HAS_POWER_SWITCH
 static bool cmd_target_power(target *t, int argc, const char **argv);
 #endif
 #ifdef PLATFORM_HAS_TRACESWO
 static bool cmd_traceswo(target *t, int argc, const char **argv);
 #endif
+#ifdef PLATFORM_HAS_RTT
+static bool cmd_rtt(target *t, int argc, const char **argv);
+#endif
 #if defined(PLATFORM_HAS_DEBUG) && !defined(PC_HOSTED)
 static bool cmd_debug_bmp(target *t, int argc, const char **argv);
 #endif
@@ -73,16 +82,23 @@ const struct command_s cmd_list[] = {
 	{"halt_timeout", (cmd_handler)cmd_halt_timeout, "Timeout (ms) to wait until Cortex-M is halted: (Default 2000)" },
 	{"connect_srst", (cmd_handler)cmd_connect_srst, "Configure connect under SRST: (enable|disable)" },
 	{"hard_srst", (cmd_handler)cmd_hard_srst, "Force a pulse on the hard SRST line - disconnects target" },
+	{"flash_incremental", (cmd_handler)cmd_flash_incremental, "Skip unchanged flash blocks when loading: (enable|disable)" },
+	{"halt_poll", (cmd_handler)cmd_halt_poll, "Interval (ms) to poll a running target, backing off from min to max: (min [max]) (Default 1 32)" },
 #ifdef PLATFORM_HAS_POWER_SWITCH
 	{"tpwr", (cmd_handler)cmd_target_power, "Supplies power to the target: (enable|disable)"},
 #endif
 #ifdef PLATFORM_HAS_TRACESWO
-#if defined TRACESWO_PROTOCOL && TRACESWO_PROTOCOL == 2
+#if defined(PC_HOSTED)
+	{"traceswo", (cmd_handler)cmd_traceswo, "Start trace capture, NRZ mode: (baudrate [basename]|disable)" },
+#elif defined TRACESWO_PROTOCOL && TRACESWO_PROTOCOL == 2
 	{"traceswo", (cmd_handler)cmd_traceswo, "Start trace capture, NRZ mode: (baudrate)" },
 #else
 	{"traceswo", (cmd_handler)cmd_traceswo, "Start trace capture, Manchester mode" },
 #endif
 #endif
+#ifdef PLATFORM_HAS_RTT
+	{"rtt", (cmd_handler)cmd_rtt, "Pass SEGGER RTT channels on while the target runs: (enable|disable|control block address)" },
+#endif
 #if defined(PLATFORM_HAS_DEBUG) && !defined(PC_HOSTED)
 	{"debug_bmp", (cmd_handler)cmd_debug_bmp, "Output BMP \"debug\" strings to the second vcom: (enable|disable)"},
 #endif
@@ -90,10 +106,13 @@ const struct command_s cmd_list[] = {
 };
 
 bool connect_assert_srst;
+bool target_flash_incremental;
 #if defined(PLATFORM_HAS_DEBUG) && !defined(PC_HOSTED)
 bool debug_bmp;
 #endif
 long cortexm_wait_timeout = 2000; /* Timeout to wait for Cortex to react on halt command. */
+unsigned gdb_halt_poll_min = 1; /* Halt poll interval right after resuming */
+unsigned gdb_halt_poll_max = 32; /* Halt poll interval once backed off */
 
 int command_process(target *t, char *cmd)
 {
@@ -125,7 +144,10 @@ int command_process(target *t, char *cmd)
 	if (!t)
 		return -1;
 
-	return target_command(t, argc, argv);
+	/* Target commands may erase, unlock or remap flash behind the cache */
+	int ret = target_command(t, argc, argv);
+	target_flash_cache_flush(t);
+	return ret;
 }
 
 bool cmd_version(target *t, int argc, char **argv)
@@ -311,6 +333,27 @@ static bool cmd_connect_srst(target *t, int argc, const char **argv)
 	return true;
 }
 
+static bool cmd_flash_incremental(target *t, int argc, const char **argv)
+{
+	(void)t;
+	bool print_status = false;
+	if (argc == 1) {
+		print_status = true;
+	} else if (argc == 2) {
+		if (parse_enable_or_disable(argv[1], &target_flash_incremental)) {
+			print_status = true;
+		}
+	} else {
+		gdb_outf("Unrecognized command format\n");
+	}
+
+	if (print_status) {
+		gdb_outf("Incremental flash loading: %s\n",
+			 target_flash_incremental ? "enabled" : "disabled");
+	}
+	return true;
+}
+
 static bool cmd_halt_timeout(target *t, int argc, const char **argv)
 {
 	(void)t;
@@ -321,6 +364,18 @@ static bool cmd_halt_timeout(target *t, int argc, const char **argv)
 	return true;
 }
 
+static bool cmd_halt_poll(target *t, int argc, const char **argv)
+{
+	(void)t;
+	if (argc > 1)
+		gdb_halt_poll_min = gdb_halt_poll_max = atol(argv[1]);
+	if (argc > 2)
+		gdb_halt_poll_max = MAX((unsigned)atol(argv[2]), gdb_halt_poll_min);
+	gdb_outf("Halt poll interval: %u ms, backing off to %u ms\n",
+	         gdb_halt_poll_min, gdb_halt_poll_max);
+	return true;
+}
+
 static bool cmd_hard_srst(target *t, int argc, const char **argv)
 {
 	(void)t;
@@ -353,6 +408,28 @@ static bool cmd_target_power(target *t, int argc, const char **argv)
 #endif
 
 #ifdef PLATFORM_HAS_TRACESWO
+#if defined(PC_HOSTED)
+static bool cmd_traceswo(target *t, int argc, const char **argv)
+{
+	(void)t;
+	if (argc < 2) {
+		gdb_outf("Missing baudrate parameter in command\n");
+		return true;
+	}
+	if (!strcmp(argv[1], "disable")) {
+		traceswo_stop();
+		return true;
+	}
+	const char *basename = (argc > 2) ? argv[2] : "";
+	if (!traceswo_init(atoi(argv[1]), basename)) {
+		gdb_outf("Starting trace capture failed\n");
+		return true;
+	}
+	gdb_outf("Writing ITM channels to %schan00..%schan1F\n",
+	         basename, basename);
+	return true;
+}
+#else
 static bool cmd_traceswo(target *t, int argc, const char **argv)
 {
 #if defined(STM32L0) || defined(STM32F3) || defined(STM32F4)
@@ -379,6 +456,28 @@ static bool cmd_traceswo(target *t, int argc, const char **argv)
 	return true;
 }
 #endif
+#endif
+
+#ifdef PLATFORM_HAS_RTT
+static bool cmd_rtt(target *t, int argc, const char **argv)
+{
+	if (argc > 1) {
+		if (!strcmp(argv[1], "disable"))
+			rtt_disable();
+		else if (!rtt_enable(t, strcmp(argv[1], "enable") ?
+		                        strtoul(argv[1], NULL, 0) : 0))
+			gdb_outf("Starting RTT failed\n");
+	}
+	if (!rtt_enabled())
+		gdb_outf("RTT is disabled\n");
+	else if (!rtt_control_block())
+		gdb_outf("RTT is enabled, control block not found yet\n");
+	else
+		gdb_outf("RTT control block at 0x%08" PRIx32 "\n",
+		         rtt_control_block());
+	return true;
+}
+#endif
 
 #if defined(PLATFORM_HAS_DEBUG) && !defined(PC_HOSTED)
 static bool cmd_debug_bmp(target *t, int argc, const char **argv)
@@ -20,6 +20,8 @@
 
 #include "general.h"
 #include "target.h"
+#include "target_internal.h"
+#include "crc32.h"
 
 #if !defined(STM32F0) && !defined(STM32F1) && !defined(STM32F2) && \
 	!defined(STM32F3) && !defined(STM32F4) && !defined(STM32F7) && \
@@ -97,17 +99,72 @@ static uint32_t crc32_calc(uint32_t crc, uint8_t data)
 	return (crc << 8) ^ crc32_table[((crc >> 24) ^ data) & 255];
 }
 
-uint32_t generic_crc32(target *t, uint32_t base, size_t len)
+#if defined(PC_HOSTED)
+/* Larger reads amortise the per transfer overhead of the adapter */
+# define CRC32_READ_SIZE	4096
+
+/* Slice-by-8: crc32_slice[k][i] is the CRC of byte i followed by k zero
+ * bytes, so eight bytes are folded in with eight independent lookups. */
+static uint32_t crc32_slice[8][256];
+
+static void crc32_slice_init(void)
+{
+	static bool initialised;
+
+	if (initialised)
+		return;
+	for (int i = 0; i < 256; i++)
+		crc32_slice[0][i] = crc32_table[i];
+	for (int k = 1; k < 8; k++)
+		for (int i = 0; i < 256; i++)
+			crc32_slice[k][i] = crc32_calc(crc32_slice[k - 1][i], 0);
+	initialised = true;
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+	crc32_slice_init();
+	for (; len >= 8; data += 8, len -= 8) {
+		crc ^= (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+		       (uint32_t)data[2] << 8 | data[3];
+		crc = crc32_slice[7][crc >> 24] ^
+		      crc32_slice[6][(crc >> 16) & 255] ^
+		      crc32_slice[5][(crc >> 8) & 255] ^
+		      crc32_slice[4][crc & 255] ^
+		      crc32_slice[3][data[4]] ^
+		      crc32_slice[2][data[5]] ^
+		      crc32_slice[1][data[6]] ^
+		      crc32_slice[0][data[7]];
+	}
+	while (len--)
+		crc = crc32_calc(crc, *data++);
+	return crc;
+}
+#else
+# define CRC32_READ_SIZE	128
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+	while (len--)
+		crc = crc32_calc(crc, *data++);
+	return crc;
+}
+#endif
+
+uint32_t crc32_buffer(const void *buf, size_t len)
+{
+	return crc32_update(-1, buf, len);
+}
+
+static uint32_t crc32_read(target *t, uint32_t base, size_t len)
 {
 	uint32_t crc = -1;
-	uint8_t bytes[128];
+	uint8_t bytes[CRC32_READ_SIZE];
 
 	while (len) {
 		size_t read_len = MIN(sizeof(bytes), len);
 		target_mem_read(t, bytes, base, read_len);
-
-		for (unsigned i = 0; i < read_len; i++)
-			crc = crc32_calc(crc, bytes[i]);
+		crc = crc32_update(crc, bytes, read_len);
 
 		base += read_len;
 		len -= read_len;
@@ -116,7 +173,35 @@ uint32_t generic_crc32(target *t, uint32_t base, size_t len)
 }
 #else
 #include <libopencm3/stm32/crc.h>
-uint32_t generic_crc32(target *t, uint32_t base, size_t len)
+static uint32_t crc32_tail(uint32_t crc, const uint8_t *data, size_t len)
+{
+	while (len--) {
+		crc ^= *data++ << 24;
+		for (int i = 0; i < 8; i++) {
+			if (crc & 0x80000000)
+				crc = (crc << 1) ^ 0x4C11DB7;
+			else
+				crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+uint32_t crc32_buffer(const void *buf, size_t len)
+{
+	const uint8_t *data = buf;
+
+	CRC_CR |= CRC_CR_RESET;
+
+	for (; len > 3; data += 4, len -= 4) {
+		uint32_t word;
+		memcpy(&word, data, sizeof(word));
+		CRC_DR = __builtin_bswap32(word);
+	}
+	return crc32_tail(CRC_DR, data, len);
+}
+
+static uint32_t crc32_read(target *t, uint32_t base, size_t len)
 {
 	uint8_t bytes[128];
 	uint32_t crc;
@@ -137,17 +222,16 @@ uint32_t generic_crc32(target *t, uint32_t base, size_t len)
 	crc = CRC_DR;
 
 	target_mem_read(t, bytes, base, len);
-	uint8_t *data = bytes;
-	while (len--) {
-		crc ^= *data++ << 24;
-		for (int i = 0; i < 8; i++) {
-			if (crc & 0x80000000)
-				crc = (crc << 1) ^ 0x4C11DB7;
-			else
-				crc <<= 1;
-		}
-	}
-	return crc;
+	return crc32_tail(crc, bytes, len);
 }
 #endif
 
+uint32_t generic_crc32(target *t, uint32_t base, size_t len)
+{
+	uint32_t crc;
+
+	/* Only the result crosses the wire if the target can compute it */
+	if (t->mem_crc32 && t->mem_crc32(t, base, len, &crc))
+		return crc;
+	return crc32_read(t, base, len);
+}
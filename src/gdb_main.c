@@ -30,28 +30,114 @@
 #include "gdb_packet.h"
 #include "gdb_main.h"
 #include "gdb_hostio.h"
+#include "gdb_trace.h"
 #include "target.h"
 #include "command.h"
 #include "crc32.h"
 #include "morse.h"
+#if defined(PLATFORM_HAS_RTT)
+#	include "rtt.h"
+#endif
 
 enum gdb_signal {
+	GDB_SIG0 = 0,
 	GDB_SIGINT = 2,
 	GDB_SIGTRAP = 5,
 	GDB_SIGSEGV = 11,
 	GDB_SIGLOST = 29,
 };
 
-#define BUF_SIZE	1024
+/* Largest packet GDB may send us. Platforms with RAM to spare may raise
+ * it in platform.h. The hosted build allocates the buffer on the heap and
+ * allows the size to be changed on the command line. */
+#if !defined(GDB_PACKET_BUFFER_SIZE)
+# if defined(PC_HOSTED)
+#  define GDB_PACKET_BUFFER_SIZE	(64 * 1024)
+# else
+#  define GDB_PACKET_BUFFER_SIZE	1024
+# endif
+#endif
 
 #define ERROR_IF_NO_TARGET()	\
 	if(!cur_target) { gdb_putpacketz("EFF"); break; }
+#define ERROR_IF_RUNNING()	\
+	if(target_running) { gdb_putpacketz("E01"); break; }
 
-static char pbuf[BUF_SIZE+1];
+#if defined(PC_HOSTED)
+size_t gdb_packet_size = GDB_PACKET_BUFFER_SIZE;
+static char *pbuf;
+#else
+#define gdb_packet_size	GDB_PACKET_BUFFER_SIZE
+static char pbuf[GDB_PACKET_BUFFER_SIZE + 1];
+#endif
 
 static target *cur_target;
 static target *last_target;
 
+/* In non-stop mode GDB keeps talking to us while the target runs. Halts
+ * are then reported with %Stop notifications. */
+static bool non_stop;
+static bool target_running;
+static void gdb_set_non_stop(bool enable);
+
+#if defined(PLATFORM_HAS_RTT)
+/* Set when RTT moved data, halt polling then stays at the shortest
+ * interval */
+static bool rtt_busy;
+#endif
+
+#if defined(PC_HOSTED)
+/* Every client of gdb_if has its own session. The state of the current
+ * session lives in the variables above and is swapped on a switch.
+ * Sessions take turns at packet granularity, so only one of them talks
+ * to the probe at any time. */
+struct gdb_session {
+	target *cur_target;
+	target *last_target;
+	bool non_stop;
+	bool target_running;
+	bool noackmode;
+};
+
+static struct gdb_session sessions[GDB_IF_MAX_CLIENTS];
+static int cur_session;
+
+static void gdb_session_switch(int n)
+{
+	struct gdb_session *s = &sessions[cur_session];
+
+	if (n == cur_session)
+		return;
+	s->cur_target = cur_target;
+	s->last_target = last_target;
+	s->non_stop = non_stop;
+	s->target_running = target_running;
+	s->noackmode = gdb_noackmode();
+
+	s = &sessions[n];
+	cur_target = s->cur_target;
+	last_target = s->last_target;
+	gdb_set_non_stop(s->non_stop);
+	target_running = s->target_running;
+	gdb_set_noackmode(s->noackmode);
+	cur_session = n;
+	gdb_if_select(n);
+}
+
+/* Give the current session the state of a new connection, a slot is
+ * reused by the next client. */
+static void gdb_session_reset(void)
+{
+	if (cur_target)
+		target_detach(cur_target);
+	cur_target = NULL;
+	last_target = NULL;
+	target_running = false;
+	gdb_set_non_stop(false);
+	gdb_set_noackmode(false);
+}
+#endif
+
 static void handle_q_packet(char *packet, int len);
 static void handle_v_packet(char *packet, int len);
 static void handle_z_packet(char *packet, int len);
@@ -64,6 +150,18 @@ static void gdb_target_destroy_callback(struct target_controller *tc, target *t)
 
 	if (last_target == t)
 		last_target = NULL;
+#if defined(PLATFORM_HAS_RTT)
+	rtt_target_destroyed(t);
+#endif
+	trace_target_destroyed(t);
+#if defined(PC_HOSTED)
+	for (int i = 0; i < GDB_IF_MAX_CLIENTS; i++) {
+		if (sessions[i].cur_target == t)
+			sessions[i].cur_target = NULL;
+		if (sessions[i].last_target == t)
+			sessions[i].last_target = NULL;
+	}
+#endif
 }
 
 static void gdb_target_printf(struct target_controller *tc,
@@ -73,9 +171,17 @@ static void gdb_target_printf(struct target_controller *tc,
 	gdb_voutf(fmt, ap);
 }
 
+static void gdb_target_console(struct target_controller *tc,
+                               const char *buf, size_t len)
+{
+	(void)tc;
+	gdb_out_len(buf, len);
+}
+
 static struct target_controller gdb_controller = {
 	.destroy_callback = gdb_target_destroy_callback,
 	.printf = gdb_target_printf,
+	.console = gdb_target_console,
 
 	.open = hostio_open,
 	.close = hostio_close,
@@ -91,6 +197,175 @@ static struct target_controller gdb_controller = {
 	.system = hostio_system,
 };
 
+/* GDB doesn't take File-I/O requests in non-stop mode */
+static void gdb_set_non_stop(bool enable)
+{
+	non_stop = enable;
+	gdb_controller.no_fileio = enable;
+}
+
+/* Registers sent along with every stop reply, so GDB does not need a 'g'
+ * packet to find out where the target stopped. These are SP, LR, PC and
+ * xPSR/CPSR in the ARM register numbering used by all our targets. */
+static const uint8_t expedite_regs[] = {13, 14, 15, 16};
+
+/* Report a halt as a stop reply or, with notify set, as a %Stop
+ * notification. */
+static void gdb_report_halt(enum target_halt_reason reason,
+                            target_addr watch, bool notify)
+{
+	const char *prefix = notify ? "Stop:" : "";
+	enum gdb_signal sig = GDB_SIGTRAP;
+	int len;
+
+	if (reason == TARGET_HALT_ERROR) {
+		len = snprintf(pbuf, gdb_packet_size, "%sX%02X", prefix, GDB_SIGLOST);
+		morse("TARGET LOST.", true);
+	} else {
+		if (reason == TARGET_HALT_REQUEST)
+			sig = non_stop ? GDB_SIG0 : GDB_SIGINT;
+		else if (reason == TARGET_HALT_FAULT)
+			sig = GDB_SIGSEGV;
+		len = snprintf(pbuf, gdb_packet_size, "%sT%02X", prefix, sig);
+		if (reason == TARGET_HALT_WATCHPOINT)
+			len += snprintf(pbuf + len, gdb_packet_size - len,
+			                "watch:%08" PRIX32 ";", watch);
+		if (non_stop)
+			len += snprintf(pbuf + len, gdb_packet_size - len,
+			                "thread:1;");
+		for (size_t i = 0; i < ARRAY_NUMELEM(expedite_regs); i++) {
+			uint8_t val[4];
+			if (target_reg_read(cur_target, expedite_regs[i], val,
+			                    sizeof(val)) != sizeof(val))
+				continue;
+			len += snprintf(pbuf + len, gdb_packet_size - len, "%02x:",
+			                expedite_regs[i]);
+			hexify(pbuf + len, val, sizeof(val));
+			len += sizeof(val) * 2;
+			pbuf[len++] = ';';
+		}
+	}
+	if (notify)
+		gdb_putnotification(pbuf, len);
+	else
+		gdb_putpacket(pbuf, len);
+}
+
+/* Wait for the target to halt and report why. The interval between polls
+ * doubles while the target keeps running, leaving the link idle. Waiting
+ * for GDB input ends at once when a character arrives. */
+static void gdb_wait_halt(void)
+{
+	target_addr watch;
+	enum target_halt_reason reason;
+	unsigned interval = gdb_halt_poll_min;
+
+	while(!(reason = target_halt_poll(cur_target, &watch))) {
+		unsigned char c = gdb_if_getchar_to(interval);
+		if((c == '\x03') || (c == '\x04')) {
+			target_halt_request(cur_target);
+			interval = gdb_halt_poll_min;
+			continue;
+		}
+		interval = MIN(MAX(interval * 2, 1U), gdb_halt_poll_max);
+	}
+	SET_RUN_STATE(0);
+	gdb_report_halt(reason, watch, false);
+}
+
+/* Poll the target of the current session and report a halt. Returns true
+ * while the target keeps running. */
+static bool gdb_poll_halt(void)
+{
+	target_addr watch;
+	enum target_halt_reason reason;
+
+	if (!target_running)
+		return false;
+	if (!cur_target) {
+		/* The target went away while running, e.g. taken by another
+		 * session's attach. GDB still waits for a stop, so tell it. */
+		target_running = false;
+		SET_RUN_STATE(0);
+		gdb_report_halt(TARGET_HALT_ERROR, 0, non_stop);
+		return false;
+	}
+	reason = target_halt_poll(cur_target, &watch);
+	if (!reason) {
+#if defined(PLATFORM_HAS_RTT)
+		if (rtt_poll(cur_target))
+			rtt_busy = true;
+#endif
+		trace_poll();
+		return true;
+	}
+	target_running = false;
+	SET_RUN_STATE(0);
+#if defined(PLATFORM_HAS_RTT)
+	rtt_target_halted(cur_target);
+#endif
+	gdb_report_halt(reason, watch, non_stop);
+	return false;
+}
+
+/* Poll running targets until GDB starts a packet. The interval between
+ * polls backs off like in gdb_wait_halt(). */
+static void gdb_poll_running(void)
+{
+	unsigned interval = gdb_halt_poll_min;
+
+	while (1) {
+#if defined(PC_HOSTED)
+		bool running = false;
+		for (int n = 0; n < GDB_IF_MAX_CLIENTS; n++) {
+			bool r = (n == cur_session) ? target_running :
+			                              sessions[n].target_running;
+			if (!r)
+				continue;
+			gdb_session_switch(n);
+			running |= gdb_poll_halt();
+		}
+		int n = gdb_if_wait(running ? (int)interval : -1);
+		if (n >= 0) {
+			gdb_session_switch(n);
+			if (gdb_if_accepted(n))
+				gdb_session_reset();
+			if (gdb_packet_pending(0))
+				return;
+		}
+#else
+		if (!gdb_poll_halt())
+			return;
+		if (gdb_packet_pending(interval))
+			return;
+#endif
+#if defined(PLATFORM_HAS_RTT)
+		if (rtt_busy) {
+			rtt_busy = false;
+			interval = gdb_halt_poll_min;
+			continue;
+		}
+#endif
+		/* Tracepoint hits keep the target halted until polled */
+		if (trace_active()) {
+			interval = gdb_halt_poll_min;
+			continue;
+		}
+		interval = MIN(MAX(interval * 2, 1U), gdb_halt_poll_max);
+	}
+}
+
+/* The halt is reported by gdb_poll_running(), GDB is not blocked meanwhile
+ * in non-stop mode. */
+static void gdb_resume(bool step)
+{
+	target_halt_resume(cur_target, step);
+	SET_RUN_STATE(1);
+	target_running = true;
+	if (non_stop)
+		gdb_putpacketz("OK");
+}
+
 int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 {
 	int size;
@@ -98,13 +373,22 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 
 	/* GDB protocol main loop */
 	while(1) {
+		/* Semihosting calls are only made by a halted target. The
+		 * client of the call keeps the link until it is done. */
+		if (!in_syscall)
+			gdb_poll_running();
 		SET_IDLE_STATE(1);
-		size = gdb_getpacket(pbuf, BUF_SIZE);
+		size = gdb_getpacket(pbuf, gdb_packet_size);
 		SET_IDLE_STATE(0);
 		switch(pbuf[0]) {
 		/* Implementation of these is mandatory! */
 		case 'g': { /* 'g': Read general registers */
 			ERROR_IF_NO_TARGET();
+			if (trace_frame_selected()) {
+				gdb_putpacket(pbuf, trace_frame_regs(cur_target, pbuf));
+				break;
+			}
+			ERROR_IF_RUNNING();
 			uint8_t arm_regs[target_regs_size(cur_target)];
 			target_regs_read(cur_target, arm_regs);
 			gdb_putpacket(hexify(pbuf, arm_regs, sizeof(arm_regs)),
@@ -115,20 +399,53 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 			uint32_t addr, len;
 			ERROR_IF_NO_TARGET();
 			sscanf(pbuf, "m%" SCNx32 ",%" SCNx32, &addr, &len);
-			if (len > sizeof(pbuf) / 2) {
+			if (len > gdb_packet_size / 2) {
 				gdb_putpacketz("E02");
 				break;
 			}
 			DEBUG("m packet: addr = %" PRIx32 ", len = %" PRIx32 "\n", addr, len);
-			uint8_t mem[len];
-			if (target_mem_read(cur_target, mem, addr, len))
+			/* Read into the upper half of pbuf and hexify in place.
+			 * Each byte is read before its slot is overwritten. */
+			uint8_t *mem = (uint8_t *)pbuf + len;
+			if (trace_frame_selected()) {
+				/* Only what the trace frame holds */
+				len = trace_frame_mem(mem, addr, len);
+				if (len)
+					gdb_putpacket(hexify(pbuf, mem, len), len*2);
+				else
+					gdb_putpacketz("E01");
+			} else if (target_mem_read(cur_target, mem, addr, len))
 				gdb_putpacketz("E01");
 			else
 				gdb_putpacket(hexify(pbuf, mem, len), len*2);
 			break;
 			}
+		case 'x': {	/* 'x addr,len': Read len bytes from addr as binary */
+			uint32_t addr, len;
+			ERROR_IF_NO_TARGET();
+			sscanf(pbuf, "x%" SCNx32 ",%" SCNx32, &addr, &len);
+			if (len > gdb_packet_size - 1) {
+				gdb_putpacketz("E02");
+				break;
+			}
+			DEBUG("x packet: addr = %" PRIx32 ", len = %" PRIx32 "\n", addr, len);
+			/* gdb_putpacket() escapes the data on the fly */
+			pbuf[0] = 'b';
+			if (trace_frame_selected()) {
+				len = trace_frame_mem(pbuf + 1, addr, len);
+				if (len)
+					gdb_putpacket(pbuf, len + 1);
+				else
+					gdb_putpacketz("E01");
+			} else if (target_mem_read(cur_target, pbuf + 1, addr, len))
+				gdb_putpacketz("E01");
+			else
+				gdb_putpacket(pbuf, len + 1);
+			break;
+			}
 		case 'G': {	/* 'G XX': Write general registers */
 			ERROR_IF_NO_TARGET();
+			ERROR_IF_RUNNING();
 			uint8_t arm_regs[target_regs_size(cur_target)];
 			unhexify(arm_regs, &pbuf[1], sizeof(arm_regs));
 			target_regs_write(cur_target, arm_regs);
@@ -145,9 +462,9 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 				break;
 			}
 			DEBUG("M packet: addr = %" PRIx32 ", len = %" PRIx32 "\n", addr, len);
-			uint8_t mem[len];
-			unhexify(mem, pbuf + hex, len);
-			if (target_mem_write(cur_target, addr, mem, len))
+			/* Decode in place, the output never overtakes the input */
+			unhexify(pbuf, pbuf + hex, len);
+			if (target_mem_write(cur_target, addr, pbuf, len))
 				gdb_putpacketz("E01");
 			else
 				gdb_putpacketz("OK");
@@ -162,57 +479,40 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 				break;
 			}
 
-			target_halt_resume(cur_target, single_step);
-			SET_RUN_STATE(1);
+			gdb_resume(single_step);
 			single_step = false;
-			/* fall through */
-		case '?': {	/* '?': Request reason for target halt */
+			break;
+
+		case '?':	/* '?': Request reason for target halt */
 			/* This packet isn't documented as being mandatory,
 			 * but GDB doesn't work without it. */
-			target_addr watch;
-			enum target_halt_reason reason;
-
 			if(!cur_target) {
 				/* Report "target exited" if no target */
 				gdb_putpacketz("W00");
-				break;
-			}
-
-			/* Wait for target halt */
-			while(!(reason = target_halt_poll(cur_target, &watch))) {
-				unsigned char c = gdb_if_getchar_to(0);
-				if((c == '\x03') || (c == '\x04')) {
-					target_halt_request(cur_target);
-				}
-			}
-			SET_RUN_STATE(0);
-
-			/* Translate reason to GDB signal */
-			switch (reason) {
-			case TARGET_HALT_ERROR:
-				gdb_putpacket_f("X%02X", GDB_SIGLOST);
-				morse("TARGET LOST.", true);
-				break;
-			case TARGET_HALT_REQUEST:
-				gdb_putpacket_f("T%02X", GDB_SIGINT);
-				break;
-			case TARGET_HALT_WATCHPOINT:
-				gdb_putpacket_f("T%02Xwatch:%08X;", GDB_SIGTRAP, watch);
-				break;
-			case TARGET_HALT_FAULT:
-				gdb_putpacket_f("T%02X", GDB_SIGSEGV);
-				break;
-			default:
-				gdb_putpacket_f("T%02X", GDB_SIGTRAP);
+			} else if (target_running) {
+				/* Non-stop mode has no halt to report, all-stop
+				 * mode reports it once the target halts */
+				if (non_stop)
+					gdb_putpacketz("OK");
+			} else {
+				gdb_wait_halt();
 			}
 			break;
-			}
 
 		/* Optional GDB packet support */
 		case 'p': { /* Read single register */
 			ERROR_IF_NO_TARGET();
 			uint32_t reg;
 			sscanf(pbuf, "p%" SCNx32, &reg);
+			if (trace_frame_selected()) {
+				size_t n = trace_frame_reg(cur_target, reg, pbuf);
+				if (n)
+					gdb_putpacket(pbuf, n);
+				else
+					gdb_putpacketz("EFF");
+				break;
+			}
+			ERROR_IF_RUNNING();
 			uint8_t val[8];
 			size_t s = target_reg_read(cur_target, reg, val, sizeof(val));
 			if (s > 0) {
@@ -224,12 +524,13 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 			}
 		case 'P': { /* Write single register */
 			ERROR_IF_NO_TARGET();
+			ERROR_IF_RUNNING();
 			uint32_t reg;
 			int n;
 			sscanf(pbuf, "P%" SCNx32 "=%n", &reg, &n);
-			uint8_t val[strlen(&pbuf[n])/2];
-			unhexify(val, pbuf + n, sizeof(val));
-			if (target_reg_write(cur_target, reg, val, sizeof(val)) > 0) {
+			size_t len = strlen(&pbuf[n]) / 2;
+			unhexify(pbuf, pbuf + n, len);
+			if (target_reg_write(cur_target, reg, pbuf, len) > 0) {
 				gdb_putpacketz("OK");
 			} else {
 				gdb_putpacketz("EFF");
@@ -254,8 +555,14 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 			gdb_putpacketz("OK");
 			break;
 
+		case 0x03:	/* Interrupt from GDB in all-stop mode */
+			if (target_running && cur_target)
+				target_halt_request(cur_target);
+			break;
+
 		case 0x04:
 		case 'D':	/* GDB 'detach' command. */
+			target_running = false;
 			if(cur_target) {
 				SET_RUN_STATE(1);
 				target_detach(cur_target);
@@ -263,9 +570,15 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 			last_target = cur_target;
 			cur_target = NULL;
 			gdb_putpacketz("OK");
+#if defined(PC_HOSTED)
+			/* Only sent by gdb_if when the connection dropped */
+			if (pbuf[0] == 0x04)
+				gdb_session_reset();
+#endif
 			break;
 
 		case 'k':	/* Kill the target */
+			target_running = false;
 			if(cur_target) {
 				target_reset(cur_target);
 				target_detach(cur_target);
@@ -302,7 +615,15 @@ int gdb_main_loop(struct target_controller *tc, bool in_syscall)
 			break;
 			}
 
+		case 'H':	/* Set thread for following operations */
+		case 'T':	/* Is thread alive */
+			/* Non-stop mode has a single thread that is always
+			 * there, all-stop mode has no threads */
+			gdb_putpacketz(non_stop ? "OK" : "");
+			break;
+
 		case 'q':	/* General query packet */
+		case 'Q':	/* General set packet */
 			handle_q_packet(pbuf, size);
 			break;
 
@@ -334,12 +655,12 @@ handle_q_string_reply(const char *str, const char *param)
 		return;
 	}
 	if (addr < strlen (str)) {
-		char reply[len+2];
-		reply[0] = 'm';
-		strncpy (reply + 1, &str[addr], len);
-		if(len > strlen(&str[addr]))
-			len = strlen(&str[addr]);
-		gdb_putpacket(reply, len + 1);
+		/* The reply is built in pbuf, param is not used from here on */
+		len = MIN(len, strlen(&str[addr]));
+		len = MIN(len, gdb_packet_size - 1);
+		pbuf[0] = 'm';
+		memcpy(pbuf + 1, &str[addr], len);
+		gdb_putpacket(pbuf, len + 1);
 	} else if (addr == strlen (str)) {
 		gdb_putpacketz("l");
 	} else
@@ -355,10 +676,9 @@ handle_q_packet(char *packet, int len)
 		char *data;
 		int datalen;
 
-		/* calculate size and allocate buffer for command */
+		/* dehexify command in place */
 		datalen = (len - 6) / 2;
-		data = alloca(datalen+1);
-		/* dehexify command */
+		data = packet;
 		unhexify(data, packet+6, datalen);
 		data[datalen] = 0;	/* add terminating null */
 
@@ -371,8 +691,31 @@ handle_q_packet(char *packet, int len)
 			gdb_putpacketz("E");
 
 	} else if (!strncmp (packet, "qSupported", 10)) {
-		/* Query supported protocol features */
-		gdb_putpacket_f("PacketSize=%X;qXfer:memory-map:read+;qXfer:features:read+", BUF_SIZE);
+		/* Query supported protocol features. A new session
+		 * starts in all-stop mode. */
+		gdb_set_non_stop(false);
+		gdb_putpacket_f("PacketSize=%X;qXfer:memory-map:read+;qXfer:features:read+;"
+		                "QStartNoAckMode+;QNonStop+;ConditionalBreakpoints+;"
+		                "ConditionalTracepoints+;binary-upload+",
+		                (unsigned)gdb_packet_size);
+
+	} else if (!strncmp(packet, "QNonStop:", 9)) {
+		gdb_set_non_stop(packet[9] == '1');
+		gdb_putpacketz("OK");
+
+	} else if (non_stop && !strcmp(packet, "qfThreadInfo")) {
+		gdb_putpacketz("m1");
+
+	} else if (non_stop && !strcmp(packet, "qsThreadInfo")) {
+		gdb_putpacketz("l");
+
+	} else if (non_stop && !strcmp(packet, "qC")) {
+		gdb_putpacketz("QC1");
+
+	} else if (!strcmp(packet, "QStartNoAckMode")) {
+		/* The OK is still acknowledged, after that neither side acks */
+		gdb_putpacketz("OK");
+		gdb_set_noackmode(true);
 
 	} else if (strncmp (packet, "qXfer:memory-map:read::", 23) == 0) {
 		/* Read target XML memory map */
@@ -408,6 +751,8 @@ handle_q_packet(char *packet, int len)
 		}
 		gdb_putpacket_f("C%lx", generic_crc32(cur_target, addr, alen));
 
+	} else if (trace_packet(cur_target, packet, len)) {
+		/* Tracepoint packet, replied to already */
 	} else {
 		DEBUG("*** Unsupported packet: %s\n", packet);
 		gdb_putpacket("", 0);
@@ -424,10 +769,38 @@ handle_v_packet(char *packet, int plen)
 	if (sscanf(packet, "vAttach;%08lx", &addr) == 1) {
 		/* Attach to remote target processor */
 		cur_target = target_attach_n(addr, &gdb_controller);
-		if(cur_target)
+		if(!cur_target) {
+			gdb_putpacketz("E01");
+		} else if (non_stop) {
+			/* The halt is sent as a notification */
+			target_running = true;
+			gdb_putpacketz("OK");
+		} else {
 			gdb_putpacketz("T05");
-		else
+		}
+
+	} else if (!strcmp(packet, "vCont?")) {
+		gdb_putpacketz("vCont;c;C;s;S;t");
+
+	} else if (!strncmp(packet, "vCont;", 6)) {
+		/* With a single thread only the first action matters */
+		if (!cur_target) {
 			gdb_putpacketz("E01");
+		} else if ((packet[6] == 'c') || (packet[6] == 'C')) {
+			gdb_resume(false);
+		} else if ((packet[6] == 's') || (packet[6] == 'S')) {
+			gdb_resume(true);
+		} else if (packet[6] == 't') {
+			if (target_running)
+				target_halt_request(cur_target);
+			gdb_putpacketz("OK");
+		} else {
+			gdb_putpacketz("E01");
+		}
+
+	} else if (!strcmp(packet, "vStopped")) {
+		/* There is at most one stop pending and it was already sent */
+		gdb_putpacketz("OK");
 
 	} else if (!strcmp(packet, "vRun;")) {
 		/* Run target program. For us (embedded) this means reset. */
@@ -482,11 +855,45 @@ handle_v_packet(char *packet, int plen)
 	}
 }
 
+/* Parse the ";X<len>,<bytecode>" conditions following a Z packet into a
+ * list. GDB sends them back to back as "X3,aabbccX2,ddee", a ';' between
+ * them is accepted too. The bytecode is converted from hex in place.
+ * Returns false for a malformed packet or when memory runs out. */
+static bool parse_z_conditions(char *packet, int plen, struct agent_expr **cond)
+{
+	char *end = packet + plen;
+	char *p = memchr(packet, ';', plen);
+
+	if (!p)
+		return true;
+	p++;
+	while ((end - p > 1) && (*p == 'X')) {
+		char *hex;
+		size_t len = strtoul(p + 1, &hex, 16);
+		if ((hex == end) || (*hex != ',') ||
+		    (len > (size_t)(end - hex - 1) / 2))
+			goto error;
+		hex++;
+		p = hex + 2 * len;
+		unhexify(hex, hex, len);
+		struct agent_expr *x = agent_expr_new((uint8_t *)hex, len, *cond);
+		if (!x)
+			goto error;
+		*cond = x;
+		if ((end - p > 1) && (p[0] == ';') && (p[1] == 'X'))
+			p++;
+	}
+	return true;
+
+error:
+	agent_expr_free(*cond);
+	*cond = NULL;
+	return false;
+}
+
 static void
 handle_z_packet(char *packet, int plen)
 {
-	(void)plen;
-
 	uint8_t set = (packet[0] == 'Z') ? 1 : 0;
 	int type, len;
 	uint32_t addr;
@@ -497,9 +904,14 @@ handle_z_packet(char *packet, int plen)
 	//sscanf(packet, "%*[zZ]%hhd,%08lX,%hhd", &type, &addr, &len);
 	type = packet[1] - '0';
 	sscanf(packet + 2, ",%" PRIx32 ",%d", &addr, &len);
-	if(set)
-		ret = target_breakwatch_set(cur_target, type, addr, len);
-	else
+	if(set) {
+		struct agent_expr *cond = NULL;
+		if (!parse_z_conditions(packet, plen, &cond)) {
+			gdb_putpacketz("E02");
+			return;
+		}
+		ret = target_breakwatch_set_cond(cur_target, type, addr, len, cond);
+	} else
 		ret = target_breakwatch_clear(cur_target, type, addr, len);
 
 	if (ret < 0) {
@@ -513,5 +925,15 @@ handle_z_packet(char *packet, int plen)
 
 void gdb_main(void)
 {
+#if defined(PC_HOSTED)
+	if (!pbuf) {
+		pbuf = malloc(gdb_packet_size + 1);
+		if (!pbuf) {
+			fprintf(stderr, "Can not allocate %u bytes GDB packet buffer\n",
+			        (unsigned)gdb_packet_size);
+			exit(1);
+		}
+	}
+#endif
 	gdb_main_loop(&gdb_controller, false);
 }
@@ -30,6 +30,47 @@
 
 #include <stdarg.h>
 
+/* Set by QStartNoAckMode. GDB starts every session by sending '+', which
+ * it never does in no-ack mode, so that ends it again. */
+static bool noackmode;
+
+void gdb_set_noackmode(bool enable)
+{
+	noackmode = enable;
+}
+
+bool gdb_noackmode(void)
+{
+	return noackmode;
+}
+
+/* First character of a packet already read by gdb_packet_pending() */
+static int pending_char = -1;
+
+static unsigned char gdb_packet_getchar(void)
+{
+	if (pending_char < 0)
+		return gdb_if_getchar();
+	unsigned char c = pending_char;
+	pending_char = -1;
+	return c;
+}
+
+bool gdb_packet_pending(int timeout)
+{
+	if (pending_char >= 0)
+		return true;
+	unsigned char c = gdb_if_getchar_to(timeout);
+	if ((c == '$') || (c == REMOTE_SOM) || (c == 0x03) || (c == 0x04)) {
+		pending_char = c;
+		return true;
+	}
+	/* A new GDB starts with an ack, as in gdb_getpacket() */
+	if (c == '+')
+		noackmode = false;
+	return false;
+}
+
 int gdb_getpacket(char *packet, int size)
 {
 	unsigned char c;
@@ -44,8 +85,10 @@ int gdb_getpacket(char *packet, int size)
              * start ('$') or a BMP remote packet start ('!').
 			 */
 			do {
-				packet[0] = gdb_if_getchar();
-				if (packet[0]==0x04) return 1;
+				packet[0] = gdb_packet_getchar();
+				if ((packet[0]==0x03) || (packet[0]==0x04))
+					return 1;
+				if (packet[0]=='+') noackmode = false;
 			} while ((packet[0] != '$') && (packet[0] != REMOTE_SOM));
 #ifndef OWN_HL
 			if (packet[0]==REMOTE_SOM) {
@@ -113,9 +156,11 @@ int gdb_getpacket(char *packet, int size)
 		if(csum == strtol(recv_csum, NULL, 16)) break;
 
 		/* get here if checksum fails */
-		gdb_if_putchar('-', 1); /* send nack */
+		if (!noackmode)
+			gdb_if_putchar('-', 1); /* send nack */
 	}
-	gdb_if_putchar('+', 1); /* send ack */
+	if (!noackmode)
+		gdb_if_putchar('+', 1); /* send ack */
 	packet[i] = 0;
 
 #ifdef DEBUG_GDBPACKET
@@ -132,12 +177,43 @@ int gdb_getpacket(char *packet, int size)
 	return i;
 }
 
-void gdb_putpacket(const char *packet, int size)
+/* Formatted packets and console output are built here rather than on
+ * the heap. Longer output is truncated. */
+#if defined(PC_HOSTED)
+#define GDB_FORMAT_BUFFER_SIZE	1024
+#else
+#define GDB_FORMAT_BUFFER_SIZE	256
+#endif
+
+static char format_buf[GDB_FORMAT_BUFFER_SIZE];
+
+static const char hexdigits[] = "0123456789abcdef";
+
+static void gdb_putchar_escaped(unsigned char c, unsigned char *csum)
+{
+#ifdef DEBUG_GDBPACKET
+	if ((c >= 32) && (c < 127))
+		DEBUG("%c", c);
+	else
+		DEBUG("\\x%02X", c);
+#endif
+	if((c == '$') || (c == '#') || (c == '}') || (c == '*')) {
+		gdb_if_putchar('}', 0);
+		*csum += '}';
+		c ^= 0x20;
+	}
+	gdb_if_putchar(c, 0);
+	*csum += c;
+}
+
+/* Send prefix, if non-zero, followed by size bytes of packet. With hex set
+ * the data is hex encoded on the fly. Escaping and the checksum are done in
+ * the same pass and the interface is flushed once per attempt. Packets
+ * starting with '%' are notifications, which are not acknowledged. */
+static void gdb_sendpacket(char start, char prefix, const char *packet,
+                           int size, bool hex)
 {
-	int i;
 	unsigned char csum;
-	unsigned char c;
-	char xmit_csum[3];
 	int tries = 0;
 
 	do {
@@ -145,66 +221,66 @@ void gdb_putpacket(const char *packet, int size)
 		DEBUG("%s : ", __func__);
 #endif
 		csum = 0;
-		gdb_if_putchar('$', 0);
-		for(i = 0; i < size; i++) {
-			c = packet[i];
-#ifdef DEBUG_GDBPACKET
-			if ((c >= 32) && (c < 127))
-				DEBUG("%c", c);
-			else
-				DEBUG("\\x%02X", c);
-#endif
-			if((c == '$') || (c == '#') || (c == '}')) {
-				gdb_if_putchar('}', 0);
-				gdb_if_putchar(c ^ 0x20, 0);
-				csum += '}' + (c ^ 0x20);
+		gdb_if_putchar(start, 0);
+		if (prefix)
+			gdb_putchar_escaped(prefix, &csum);
+		for(int i = 0; i < size; i++) {
+			unsigned char c = packet[i];
+			if (hex) {
+				gdb_putchar_escaped(hexdigits[c >> 4], &csum);
+				gdb_putchar_escaped(hexdigits[c & 0xf], &csum);
 			} else {
-				gdb_if_putchar(c, 0);
-				csum += c;
+				gdb_putchar_escaped(c, &csum);
 			}
 		}
 		gdb_if_putchar('#', 0);
-		snprintf(xmit_csum, sizeof(xmit_csum), "%02X", csum);
-		gdb_if_putchar(xmit_csum[0], 0);
-		gdb_if_putchar(xmit_csum[1], 1);
+		gdb_if_putchar(hexdigits[csum >> 4], 0);
+		gdb_if_putchar(hexdigits[csum & 0xf], 1);
 #ifdef DEBUG_GDBPACKET
 		DEBUG("\n");
 #endif
-	} while((gdb_if_getchar_to(2000) != '+') && (tries++ < 3));
+	} while((start == '$') && !noackmode &&
+	        (gdb_if_getchar_to(2000) != '+') && (tries++ < 3));
+}
+
+void gdb_putpacket(const char *packet, int size)
+{
+	gdb_sendpacket('$', 0, packet, size, false);
+}
+
+void gdb_putnotification(const char *packet, int size)
+{
+	gdb_sendpacket('%', 0, packet, size, false);
 }
 
 void gdb_putpacket_f(const char *fmt, ...)
 {
 	va_list ap;
-	char *buf;
 	int size;
 
 	va_start(ap, fmt);
-	size = vasprintf(&buf, fmt, ap);
-	gdb_putpacket(buf, size);
-	free(buf);
+	size = vsnprintf(format_buf, sizeof(format_buf), fmt, ap);
 	va_end(ap);
+	if (size < 0)
+		return;
+	gdb_putpacket(format_buf, MIN((size_t)size, sizeof(format_buf) - 1));
 }
 
 void gdb_out(const char *buf)
 {
-	char *hexdata;
-	int i;
+	gdb_out_len(buf, strlen(buf));
+}
 
-	hexdata = alloca((i = strlen(buf)*2 + 1) + 1);
-	hexdata[0] = 'O';
-	hexify(hexdata+1, buf, strlen(buf));
-	gdb_putpacket(hexdata, i);
+void gdb_out_len(const char *buf, size_t len)
+{
+	gdb_sendpacket('$', 'O', buf, len, true);
 }
 
 void gdb_voutf(const char *fmt, va_list ap)
 {
-	char *buf;
-
-	if (vasprintf(&buf, fmt, ap) < 0)
+	if (vsnprintf(format_buf, sizeof(format_buf), fmt, ap) < 0)
 		return;
-	gdb_out(buf);
-	free(buf);
+	gdb_out(format_buf);
 }
 
 void gdb_outf(const char *fmt, ...)
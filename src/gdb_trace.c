@@ -0,0 +1,780 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file implements GDB tracepoints, see "Tracepoint Packets" in
+ * "Debugging with GDB".
+ *
+ * Tracepoints are hardware breakpoints with a hook. At a hit the hook
+ * collects registers and memory into the trace buffer while the target
+ * is halted, and the target resumes without GDB hearing of it. GDB later
+ * selects the collected frames with QTFrame and reads them with the usual
+ * register and memory packets.
+ *
+ * The buffer holds frames back to back, each a struct trace_frame
+ * followed by blocks of collected data. Blocks of type 'R' hold all
+ * registers in 'g' packet layout, 'r' a single register numbered by addr
+ * and 'M' target memory.
+ */
+
+#include "general.h"
+#include "hex_utils.h"
+#include "gdb_packet.h"
+#include "gdb_trace.h"
+
+#if !defined(TRACE_BUFFER_SIZE)
+# if defined(PC_HOSTED)
+#  define TRACE_BUFFER_SIZE	(1024 * 1024)
+# else
+#  define TRACE_BUFFER_SIZE	1024
+# endif
+#endif
+
+#define TRACE_ALIGN(x)	(((x) + 3) & ~3)
+/* Base register of 'M' actions for absolute addresses */
+#define TRACE_ABSOLUTE	0xffffffff
+/* The PC in the ARM register numbering used by all our targets */
+#define TRACE_PC_REG	15
+
+struct trace_action {
+	struct trace_action *next;
+	char type;
+	/* 'M' actions */
+	uint32_t basereg;
+	target_addr offset;
+	uint32_t len;
+	/* 'X' actions */
+	struct agent_expr *x;
+};
+
+struct tracepoint {
+	struct tracepoint *next;
+	uint32_t num;
+	target_addr addr;
+	bool enabled;
+	uint32_t pass;
+	uint32_t hits;
+	struct agent_expr *cond;
+	struct trace_action *actions;
+	/* Target the tracepoint is inserted in and whether it owns the
+	 * hook at its address */
+	target *t;
+	bool hooked;
+};
+
+struct trace_frame {
+	uint32_t len;
+	uint32_t tpnum;
+	target_addr addr;
+};
+
+struct trace_block {
+	target_addr addr;
+	uint32_t len;
+	char type;
+};
+
+enum trace_stop {
+	TRACE_NOTRUN,
+	TRACE_STOP,
+	TRACE_FULL,
+	TRACE_PASSCOUNT,
+	TRACE_DISCONNECTED,
+};
+
+static const char * const trace_stop_names[] = {
+	[TRACE_NOTRUN] = "tnotrun",
+	[TRACE_STOP] = "tstop",
+	[TRACE_FULL] = "tfull",
+	[TRACE_PASSCOUNT] = "tpasscount",
+	[TRACE_DISCONNECTED] = "tdisconnected",
+};
+
+static struct {
+	struct tracepoint *tps;
+	/* Target the tracepoints are inserted in */
+	target *t;
+	bool running;
+	enum trace_stop stop;
+	uint32_t stop_tp;
+	bool circular;
+	/* Bytes of the buffer holding frames */
+	size_t used;
+	unsigned frames;
+	unsigned created;
+	/* Selected by QTFrame, -1 for none */
+	int frame;
+	/* Cursor of qTfP/qTsP */
+	struct tracepoint *report;
+	/* End of the frame being collected */
+	size_t pos;
+	bool overflow;
+} trace = {
+	.frame = -1,
+};
+
+static uint32_t trace_buf[TRACE_BUFFER_SIZE / 4];
+#define trace_bytes	((uint8_t *)trace_buf)
+
+static struct trace_frame *trace_frame_at(int n)
+{
+	size_t off = 0;
+
+	if ((n < 0) || ((unsigned)n >= trace.frames))
+		return NULL;
+	while (n--)
+		off += ((struct trace_frame *)(trace_bytes + off))->len;
+	return (struct trace_frame *)(trace_bytes + off);
+}
+
+/* Block following b in frame f, the first one if b is NULL. Returns NULL
+ * at the end of the frame. */
+static struct trace_block *trace_block_next(struct trace_frame *f,
+                                            struct trace_block *b)
+{
+	uint8_t *p = b ? (uint8_t *)(b + 1) + TRACE_ALIGN(b->len) :
+	                 (uint8_t *)(f + 1);
+
+	if (p >= (uint8_t *)f + f->len)
+		return NULL;
+	return (struct trace_block *)p;
+}
+
+/* Add a block to the frame being collected. Returns its data, NULL when
+ * the buffer is full. */
+static void *trace_alloc(char type, target_addr addr, size_t len)
+{
+	size_t size = sizeof(struct trace_block) + TRACE_ALIGN(len);
+
+	if (size > TRACE_BUFFER_SIZE - trace.pos) {
+		trace.overflow = true;
+		return NULL;
+	}
+	struct trace_block *b = (struct trace_block *)(trace_bytes + trace.pos);
+	b->addr = addr;
+	b->len = len;
+	b->type = type;
+	trace.pos += size;
+	return b + 1;
+}
+
+/* Unreadable memory is left out of the frame. Returns false only when
+ * the buffer is full. */
+static bool trace_mem(target *t, target_addr addr, size_t len)
+{
+	size_t pos = trace.pos;
+	void *data = trace_alloc('M', addr, len);
+
+	if (!data)
+		return false;
+	if (target_mem_read(t, data, addr, len))
+		trace.pos = pos;
+	return true;
+}
+
+static bool trace_expr_mem(void *arg, target_addr addr, size_t len)
+{
+	return trace_mem(arg, addr, len);
+}
+
+static bool trace_reg(target *t, uint32_t reg)
+{
+	uint8_t val[8];
+	ssize_t len = target_reg_read(t, reg, val, sizeof(val));
+
+	if (len <= 0)
+		return true;
+	void *data = trace_alloc('r', reg, len);
+	if (!data)
+		return false;
+	memcpy(data, val, len);
+	return true;
+}
+
+static bool trace_read_reg32(target *t, uint32_t reg, uint32_t *val)
+{
+	uint8_t b[8];
+
+	if (target_reg_read(t, reg, b, sizeof(b)) < 4)
+		return false;
+	*val = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+	return true;
+}
+
+/* Collect a frame for tp at the end of the buffer. Returns false when it
+ * does not fit. */
+static bool trace_collect(target *t, struct tracepoint *tp)
+{
+	struct trace_frame *f = (struct trace_frame *)(trace_bytes + trace.used);
+	bool regs = false;
+
+	if (sizeof(*f) > TRACE_BUFFER_SIZE - trace.used)
+		return false;
+	trace.pos = trace.used + sizeof(*f);
+	trace.overflow = false;
+
+	for (struct trace_action *a = tp->actions; a && !trace.overflow;
+	     a = a->next) {
+		uint64_t val;
+		uint32_t base;
+
+		switch (a->type) {
+		case 'R':
+			if (regs)
+				break;
+			regs = true;
+			size_t size = target_regs_size(t);
+			void *data = trace_alloc('R', 0, size);
+			if (data)
+				target_regs_read(t, data);
+			break;
+		case 'M':
+			if (a->basereg == TRACE_ABSOLUTE)
+				trace_mem(t, a->offset, a->len);
+			else if (trace_read_reg32(t, a->basereg, &base))
+				trace_mem(t, base + a->offset, a->len);
+			break;
+		case 'X':
+			agent_expr_eval(t, a->x, &val, trace_expr_mem, t);
+			break;
+		}
+	}
+	/* GDB finds the frame's location through the PC */
+	if (!regs)
+		trace_reg(t, TRACE_PC_REG);
+	if (trace.overflow)
+		return false;
+
+	f->len = trace.pos - trace.used;
+	f->tpnum = tp->num;
+	f->addr = tp->addr;
+	trace.used = trace.pos;
+	trace.frames++;
+	trace.created++;
+	return true;
+}
+
+/* Make room in a circular buffer */
+static bool trace_drop_oldest(void)
+{
+	struct trace_frame *f = (struct trace_frame *)trace_bytes;
+
+	if (!trace.frames)
+		return false;
+	size_t len = f->len;
+	memmove(trace_bytes, trace_bytes + len, trace.used - len);
+	trace.used -= len;
+	trace.frames--;
+	if (trace.frame >= 0)
+		trace.frame--;
+	return true;
+}
+
+/* Breakpoints are not to be changed at a hit, the tracepoints are removed
+ * by trace_poll() */
+static void trace_stop(enum trace_stop reason, uint32_t tp)
+{
+	trace.running = false;
+	trace.stop = reason;
+	trace.stop_tp = tp;
+}
+
+static bool trace_hit(target *t, void *arg)
+{
+	target_addr pc;
+	(void)arg;
+
+	if (!trace.running || !trace_read_reg32(t, TRACE_PC_REG, &pc))
+		return false;
+
+	for (struct tracepoint *tp = trace.tps; tp && trace.running;
+	     tp = tp->next) {
+		uint64_t val;
+
+		if ((tp->t != t) || (tp->addr != pc))
+			continue;
+		/* Errors count as true, like for breakpoint conditions */
+		if (tp->cond &&
+		    !agent_expr_eval(t, tp->cond, &val, NULL, NULL) && !val)
+			continue;
+		tp->hits++;
+		while (!trace_collect(t, tp)) {
+			if (!trace.circular || !trace_drop_oldest()) {
+				DEBUG("Trace buffer full\n");
+				trace_stop(TRACE_FULL, 0);
+				break;
+			}
+		}
+		if (trace.running && tp->pass && (tp->hits >= tp->pass))
+			trace_stop(TRACE_PASSCOUNT, tp->num);
+	}
+	return false;
+}
+
+static void trace_remove(void)
+{
+	for (struct tracepoint *tp = trace.tps; tp; tp = tp->next) {
+		if (tp->hooked)
+			target_breakwatch_clear_hook(tp->t, tp->addr, &trace);
+		tp->hooked = false;
+		tp->t = NULL;
+	}
+	trace.t = NULL;
+}
+
+/* Tracepoints at the same address share one hook */
+static bool trace_insert(target *t)
+{
+	trace.t = t;
+	for (struct tracepoint *tp = trace.tps; tp; tp = tp->next) {
+		if (!tp->enabled)
+			continue;
+		tp->t = t;
+		tp->hooked = true;
+		for (struct tracepoint *o = trace.tps; o != tp; o = o->next)
+			if (o->hooked && (o->addr == tp->addr))
+				tp->hooked = false;
+		if (tp->hooked &&
+		    target_breakwatch_set_hook(t, tp->addr, trace_hit, &trace)) {
+			DEBUG("Can't set tracepoint at 0x%08" PRIx32 "\n",
+			      tp->addr);
+			tp->hooked = false;
+			trace_remove();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool trace_active(void)
+{
+	return trace.running && trace.t;
+}
+
+void trace_poll(void)
+{
+	if (trace.t && !trace.running)
+		trace_remove();
+}
+
+/* The breakpoints go with the target, or stay behind with a target that
+ * is attached again. Their hook then finds no tracepoint. */
+void trace_target_destroyed(target *t)
+{
+	if (trace.t != t)
+		return;
+	for (struct tracepoint *tp = trace.tps; tp; tp = tp->next) {
+		tp->hooked = false;
+		tp->t = NULL;
+	}
+	trace.t = NULL;
+	if (trace.running)
+		trace_stop(TRACE_DISCONNECTED, 0);
+}
+
+static void trace_free(struct tracepoint *tp)
+{
+	while (tp->actions) {
+		struct trace_action *a = tp->actions;
+		tp->actions = a->next;
+		agent_expr_free(a->x);
+		free(a);
+	}
+	agent_expr_free(tp->cond);
+	free(tp);
+}
+
+static struct tracepoint *trace_find(uint32_t num, target_addr addr)
+{
+	for (struct tracepoint *tp = trace.tps; tp; tp = tp->next)
+		if ((tp->num == num) && (tp->addr == addr))
+			return tp;
+	return NULL;
+}
+
+/* Parse "X<len>,<bytecode>" at *p, converting the bytecode in place */
+static struct agent_expr *trace_parse_expr(char **p)
+{
+	char *hex;
+	size_t len = strtoul(*p + 1, &hex, 16);
+
+	if ((*hex != ',') || (len > strlen(hex + 1) / 2))
+		return NULL;
+	hex++;
+	*p = hex + 2 * len;
+	unhexify(hex, hex, len);
+	return agent_expr_new((uint8_t *)hex, len, NULL);
+}
+
+/* Parse the actions of a "QTDP:-" packet. While-stepping actions are not
+ * supported. */
+static bool trace_parse_actions(struct tracepoint *tp, char *p)
+{
+	struct trace_action **tail = &tp->actions;
+
+	while (*tail)
+		tail = &(*tail)->next;
+
+	while (*p && (*p != '-')) {
+		struct trace_action a = {.type = *p};
+
+		switch (*p) {
+		case 'R':
+			/* All registers are collected, whatever the mask */
+			strtoul(p + 1, &p, 16);
+			break;
+		case 'M':
+			a.basereg = strtoul(p + 1, &p, 16);
+			if (*p != ',')
+				return false;
+			a.offset = strtoull(p + 1, &p, 16);
+			if (*p != ',')
+				return false;
+			a.len = strtoul(p + 1, &p, 16);
+			break;
+		case 'X':
+			a.x = trace_parse_expr(&p);
+			if (!a.x)
+				return false;
+			break;
+		default:
+			return false;
+		}
+
+		struct trace_action *am = malloc(sizeof(*am));
+		if (!am) {			/* malloc failed: heap exhaustion */
+			DEBUG("malloc: failed in %s\n", __func__);
+			agent_expr_free(a.x);
+			return false;
+		}
+		memcpy(am, &a, sizeof(a));
+		*tail = am;
+		tail = &am->next;
+	}
+	return true;
+}
+
+/* "QTDP:n:addr:E|D:step:pass[:Xlen,cond][-]" defines a tracepoint,
+ * "QTDP:-n:addr:actions[-]" adds actions to it */
+static bool trace_define(char *p)
+{
+	struct tracepoint tp = {0};
+	bool more = (*p == '-');
+
+	if (more)
+		p++;
+	tp.num = strtoul(p, &p, 16);
+	if (*p != ':')
+		return false;
+	tp.addr = strtoul(p + 1, &p, 16);
+	if (*p++ != ':')
+		return false;
+
+	if (more) {
+		struct tracepoint *tpm = trace_find(tp.num, tp.addr);
+		return tpm && trace_parse_actions(tpm, p);
+	}
+
+	if ((*p != 'E') && (*p != 'D'))
+		return false;
+	tp.enabled = (*p++ == 'E');
+	if (*p != ':')
+		return false;
+	/* No while-stepping */
+	if (strtoul(p + 1, &p, 16) || (*p != ':'))
+		return false;
+	tp.pass = strtoul(p + 1, &p, 16);
+	while (*p == ':') {
+		p++;
+		/* Only conditions, no fast or static tracepoints */
+		if ((*p != 'X') || tp.cond)
+			goto error;
+		tp.cond = trace_parse_expr(&p);
+		if (!tp.cond)
+			goto error;
+	}
+	if (*p && (*p != '-'))
+		goto error;
+
+	struct tracepoint *tpm = malloc(sizeof(*tpm));
+	if (!tpm) {			/* malloc failed: heap exhaustion */
+		DEBUG("malloc: failed in %s\n", __func__);
+		goto error;
+	}
+	memcpy(tpm, &tp, sizeof(tp));
+	struct tracepoint **tail = &trace.tps;
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = tpm;
+	return true;
+
+error:
+	agent_expr_free(tp.cond);
+	return false;
+}
+
+static void trace_reset(void)
+{
+	trace.used = 0;
+	trace.frames = 0;
+	trace.created = 0;
+	trace.frame = -1;
+}
+
+static void trace_init(void)
+{
+	if (trace.t)
+		trace_remove();
+	trace.running = false;
+	trace.stop = TRACE_NOTRUN;
+	trace.circular = false;
+	trace.report = NULL;
+	while (trace.tps) {
+		struct tracepoint *tp = trace.tps;
+		trace.tps = tp->next;
+		trace_free(tp);
+	}
+	trace_reset();
+}
+
+static bool trace_start(target *t)
+{
+	if (!t)
+		return false;
+	if (trace.t)
+		trace_remove();
+	trace_reset();
+	for (struct tracepoint *tp = trace.tps; tp; tp = tp->next)
+		tp->hits = 0;
+	if (!trace_insert(t))
+		return false;
+	trace.running = true;
+	trace.stop = TRACE_NOTRUN;
+	return true;
+}
+
+/* "QTFrame:n", "QTFrame:pc:addr", "QTFrame:tdp:t",
+ * "QTFrame:range:start:end" or "QTFrame:outside:start:end". All but the
+ * first search from the frame after the selected one. */
+static void trace_select_frame(char *p)
+{
+	uint32_t lo = 0, hi = 0, tdp = 0;
+	bool by_tdp = false, outside = false;
+
+	if (!strncmp(p, "pc:", 3)) {
+		lo = hi = strtoul(p + 3, NULL, 16);
+	} else if (!strncmp(p, "tdp:", 4)) {
+		tdp = strtoul(p + 4, NULL, 16);
+		by_tdp = true;
+	} else if (!strncmp(p, "range:", 6) || !strncmp(p, "outside:", 8)) {
+		outside = (*p == 'o');
+		p = strchr(p, ':');
+		lo = strtoul(p + 1, &p, 16);
+		hi = (*p == ':') ? strtoul(p + 1, NULL, 16) : lo;
+	} else {
+		uint32_t n = strtoul(p, NULL, 16);
+		if (n == 0xffffffff) {
+			trace.frame = -1;
+			gdb_putpacketz("OK");
+			return;
+		}
+		struct trace_frame *f = trace_frame_at(n);
+		if (!f) {
+			trace.frame = -1;
+			gdb_putpacketz("F-1");
+			return;
+		}
+		trace.frame = n;
+		gdb_putpacket_f("F%xT%x", (unsigned)n, (unsigned)f->tpnum);
+		return;
+	}
+
+	struct trace_frame *f = trace_frame_at(trace.frame + 1);
+	for (int n = trace.frame + 1; f; n++) {
+		bool match = by_tdp ? (f->tpnum == tdp) :
+		             (((f->addr >= lo) && (f->addr <= hi)) != outside);
+		if (match) {
+			trace.frame = n;
+			gdb_putpacket_f("F%xT%x", n, (unsigned)f->tpnum);
+			return;
+		}
+		f = (n + 1 < (int)trace.frames) ?
+		    (struct trace_frame *)((uint8_t *)f + f->len) : NULL;
+	}
+	trace.frame = -1;
+	gdb_putpacketz("F-1");
+}
+
+static void trace_report_tp(void)
+{
+	struct tracepoint *tp = trace.report;
+
+	if (!tp) {
+		gdb_putpacketz("l");
+		return;
+	}
+	trace.report = tp->next;
+	gdb_putpacket_f("T%" PRIx32 ":%08" PRIx32 ":%c:0:%" PRIx32,
+	                tp->num, tp->addr, tp->enabled ? 'E' : 'D', tp->pass);
+}
+
+bool trace_packet(target *t, char *packet, int len)
+{
+	(void)len;
+
+	if (!strcmp(packet, "QTinit")) {
+		trace_init();
+		gdb_putpacketz("OK");
+
+	} else if (!strncmp(packet, "QTDP:", 5)) {
+		if (trace_define(packet + 5))
+			gdb_putpacketz("OK");
+		else
+			gdb_putpacketz("E01");
+
+	} else if (!strcmp(packet, "QTStart")) {
+		if (trace_start(t))
+			gdb_putpacketz("OK");
+		else
+			gdb_putpacketz("E01");
+
+	} else if (!strcmp(packet, "QTStop")) {
+		if (trace.running)
+			trace_stop(TRACE_STOP, 0);
+		if (trace.t)
+			trace_remove();
+		gdb_putpacketz("OK");
+
+	} else if (!strcmp(packet, "qTStatus")) {
+		gdb_putpacket_f("T%d;%s:%" PRIx32 ";tframes:%x;tcreated:%x;"
+		                "tfree:%x;tsize:%x;circular:%d;disconn:0",
+		                trace.running, trace_stop_names[trace.stop],
+		                trace.stop_tp, trace.frames, trace.created,
+		                (unsigned)(TRACE_BUFFER_SIZE - trace.used),
+		                (unsigned)TRACE_BUFFER_SIZE, trace.circular);
+
+	} else if (!strncmp(packet, "QTFrame:", 8)) {
+		trace_select_frame(packet + 8);
+
+	} else if (!strcmp(packet, "qTfP")) {
+		trace.report = trace.tps;
+		trace_report_tp();
+
+	} else if (!strcmp(packet, "qTsP")) {
+		trace_report_tp();
+
+	} else if (!strncmp(packet, "qTP:", 4)) {
+		char *p;
+		uint32_t num = strtoul(packet + 4, &p, 16);
+		struct tracepoint *tp = NULL;
+		if (*p == ':')
+			tp = trace_find(num, strtoul(p + 1, NULL, 16));
+		if (tp)
+			gdb_putpacket_f("V%" PRIx32 ":0", tp->hits);
+		else
+			gdb_putpacketz("E01");
+
+	} else if (!strcmp(packet, "qTfV") || !strcmp(packet, "qTsV")) {
+		/* No trace state variables */
+		gdb_putpacketz("l");
+
+	} else if (!strncmp(packet, "QTBuffer:circular:", 18)) {
+		trace.circular = strtoul(packet + 18, NULL, 16);
+		gdb_putpacketz("OK");
+
+	} else if (!strncmp(packet, "QTro", 4) ||
+	           !strncmp(packet, "QTDPsrc:", 8) ||
+	           !strncmp(packet, "QTDisconnected:", 15) ||
+	           !strncmp(packet, "QTNotes:", 8)) {
+		/* Nothing to do with these */
+		gdb_putpacketz("OK");
+
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool trace_frame_selected(void)
+{
+	return trace.frame >= 0;
+}
+
+/* Hex of len bytes without the terminating NUL of hexify() */
+static void trace_hexify(char *hex, const uint8_t *data, size_t len)
+{
+	char tmp[3];
+
+	for (size_t i = 0; i < len; i++) {
+		hexify(tmp, data + i, 1);
+		memcpy(hex + 2 * i, tmp, 2);
+	}
+}
+
+size_t trace_frame_regs(target *t, char *hex)
+{
+	struct trace_frame *f = trace_frame_at(trace.frame);
+	size_t size = target_regs_size(t);
+
+	memset(hex, 'x', size * 2);
+	for (struct trace_block *b = f ? trace_block_next(f, NULL) : NULL; b;
+	     b = trace_block_next(f, b)) {
+		size_t off;
+		if (b->type == 'R')
+			trace_hexify(hex, (uint8_t *)(b + 1), MIN(b->len, size));
+		else if ((b->type == 'r') &&
+		         (target_reg_layout(t, b->addr, &off) == b->len))
+			trace_hexify(hex + off * 2, (uint8_t *)(b + 1), b->len);
+	}
+	return size * 2;
+}
+
+size_t trace_frame_reg(target *t, int reg, char *hex)
+{
+	struct trace_frame *f = trace_frame_at(trace.frame);
+	size_t off, size = target_reg_layout(t, reg, &off);
+
+	if (!size)
+		return 0;
+	memset(hex, 'x', size * 2);
+	for (struct trace_block *b = f ? trace_block_next(f, NULL) : NULL; b;
+	     b = trace_block_next(f, b)) {
+		if ((b->type == 'R') && (b->len >= off + size))
+			trace_hexify(hex, (uint8_t *)(b + 1) + off, size);
+		else if ((b->type == 'r') && (b->addr == (uint32_t)reg) &&
+		         (b->len == size))
+			trace_hexify(hex, (uint8_t *)(b + 1), size);
+	}
+	return size * 2;
+}
+
+size_t trace_frame_mem(void *dest, target_addr addr, size_t len)
+{
+	struct trace_frame *f = trace_frame_at(trace.frame);
+
+	for (struct trace_block *b = f ? trace_block_next(f, NULL) : NULL; b;
+	     b = trace_block_next(f, b)) {
+		if ((b->type != 'M') || (addr < b->addr) ||
+		    (addr - b->addr >= b->len))
+			continue;
+		size_t n = MIN(len, b->len - (addr - b->addr));
+		memcpy(dest, (uint8_t *)(b + 1) + (addr - b->addr), n);
+		return n;
+	}
+	return 0;
+}
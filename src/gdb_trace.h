@@ -0,0 +1,44 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __GDB_TRACE_H
+#define __GDB_TRACE_H
+
+#include "target.h"
+
+/* Handle a qT or QT packet. Returns false if it isn't one of ours. */
+bool trace_packet(target *t, char *packet, int len);
+/* True while tracepoints are collecting */
+bool trace_active(void);
+/* Called while the target runs, removes the tracepoints once the trace
+ * stopped by itself */
+void trace_poll(void);
+void trace_target_destroyed(target *t);
+
+/* Access to the frame selected with QTFrame */
+bool trace_frame_selected(void);
+/* Registers in 'g' packet hex, "xx" for those not collected. Returns the
+ * length of hex. */
+size_t trace_frame_regs(target *t, char *hex);
+/* Register reg in hex, returns the length of hex or 0 if unknown */
+size_t trace_frame_reg(target *t, int reg, char *hex);
+/* Copies the collected memory from addr on, up to len bytes. Returns the
+ * number of bytes copied, 0 if addr wasn't collected. */
+size_t trace_frame_mem(void *dest, target_addr addr, size_t len);
+
+#endif
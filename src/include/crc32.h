@@ -21,6 +21,8 @@
 #ifndef __CRC32_H
 #define __CRC32_H
 
-uint32_t generic_crc32(target *t, uint32_t base, int len);
+uint32_t generic_crc32(target *t, uint32_t base, size_t len);
+/* Same CRC as generic_crc32(), over a host buffer */
+uint32_t crc32_buffer(const void *buf, size_t len);
 
 #endif
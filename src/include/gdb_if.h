@@ -30,6 +30,16 @@ int gdb_if_init(void);
 unsigned char gdb_if_getchar(void);
 unsigned char gdb_if_getchar_to(int timeout);
 void gdb_if_putchar(unsigned char c, int flush);
+#if defined(PC_HOSTED)
+#define GDB_IF_MAX_CLIENTS 8
+/* Wait up to timeout ms, forever if negative, for input from any client
+ * and make that client current. Returns its index or -1 on timeout. */
+int gdb_if_wait(int timeout);
+/* Make client n current */
+void gdb_if_select(int n);
+/* True the first time it is asked after client n connected */
+bool gdb_if_accepted(int n);
+#endif
 
 #endif
 
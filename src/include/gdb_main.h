@@ -23,5 +23,14 @@
 
 void gdb_main(void);
 
+/* Interval between halt polls while the target runs, see halt_poll */
+extern unsigned gdb_halt_poll_min;
+extern unsigned gdb_halt_poll_max;
+
+#if defined(PC_HOSTED)
+/* Size of the GDB packet buffer, takes effect on the first gdb_main() */
+extern size_t gdb_packet_size;
+#endif
+
 #endif
 
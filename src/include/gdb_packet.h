@@ -23,12 +23,20 @@
 
 #include <stdarg.h>
 
+#include <stdbool.h>
+
+void gdb_set_noackmode(bool enable);
+bool gdb_noackmode(void);
 int gdb_getpacket(char *packet, int size);
+/* Wait up to timeout ms for GDB to start a packet */
+bool gdb_packet_pending(int timeout);
 void gdb_putpacket(const char *packet, int size);
+void gdb_putnotification(const char *packet, int size);
 #define gdb_putpacketz(packet) gdb_putpacket((packet), strlen(packet))
 void gdb_putpacket_f(const char *packet, ...);
 
 void gdb_out(const char *buf);
+void gdb_out_len(const char *buf, size_t len);
 void gdb_voutf(const char *fmt, va_list);
 void gdb_outf(const char *fmt, ...);
 
@@ -44,6 +44,7 @@
 #define MIN(x, y)  (((x) < (y)) ? (x) : (y))
 #undef MAX
 #define MAX(x, y)  (((x) > (y)) ? (x) : (y))
+#define ARRAY_NUMELEM(x) (sizeof(x) / sizeof((x)[0]))
 
 #endif
 
@@ -0,0 +1,56 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __RTT_H
+#define __RTT_H
+
+#include "target.h"
+
+/* Number of RTT channels passed on in each direction */
+#if !defined(RTT_MAX_CHANNELS)
+# if defined(PC_HOSTED)
+#  define RTT_MAX_CHANNELS	4
+# else
+#  define RTT_MAX_CHANNELS	1
+# endif
+#endif
+
+/* Start polling the control block at cb, or search target RAM for it if
+ * cb is 0. The block is looked for in t, or the first target polled if
+ * t is NULL. */
+bool rtt_enable(target *t, target_addr cb);
+void rtt_disable(void);
+bool rtt_enabled(void);
+/* Address of the control block in use, 0 while none is found */
+target_addr rtt_control_block(void);
+/* Called while t runs. Returns true if any data was moved. */
+bool rtt_poll(target *t);
+/* Called once t halted, host data is no longer taken then */
+void rtt_target_halted(target *t);
+void rtt_target_destroyed(target *t);
+
+/* Provided by the platform. Both calls return the number of bytes taken
+ * or given, 0 if the channel can't take or has no data. */
+int rtt_if_init(void);
+int rtt_if_write(unsigned chan, const void *buf, size_t len);
+int rtt_if_read(unsigned chan, void *buf, size_t len);
+/* Throw away host data for chan that has nowhere to go, so the host is
+ * not kept waiting for it to be read. */
+void rtt_if_discard(unsigned chan);
+
+#endif
@@ -56,12 +56,19 @@ int target_mem_write(target *t, target_addr dest, const void *src, size_t len);
 int target_flash_erase(target *t, target_addr addr, size_t len);
 int target_flash_write(target *t, target_addr dest, const void *src, size_t len);
 int target_flash_done(target *t);
+/* Forget flash contents cached since the target halted */
+void target_flash_cache_flush(target *t);
+/* Skip erasing and programming flash blocks that already hold the data */
+extern bool target_flash_incremental;
 
 /* Register access functions */
 size_t target_regs_size(target *t);
 const char *target_tdesc(target *t);
 void target_regs_read(target *t, void *data);
 void target_regs_write(target *t, const void *data);
+/* Position of reg in the target_regs_read() layout. Returns its size, 0
+ * if that is not known. */
+size_t target_reg_layout(target *t, int reg, size_t *offset);
 ssize_t target_reg_read(target *t, int reg, void *data, size_t max);
 ssize_t target_reg_write(target *t, int reg, const void *data, size_t size);
 
@@ -92,6 +99,34 @@ enum target_breakwatch {
 int target_breakwatch_set(target *t, enum target_breakwatch, target_addr, size_t);
 int target_breakwatch_clear(target *t, enum target_breakwatch, target_addr, size_t);
 
+/* Agent expressions, GDB bytecode evaluated by the probe. See agent.c */
+struct agent_expr;
+struct agent_expr *agent_expr_new(const uint8_t *code, size_t len,
+                                  struct agent_expr *next);
+void agent_expr_free(struct agent_expr *x);
+/* Collects len bytes at addr for the trace bytecodes. Returns false to
+ * end the evaluation with an error. */
+typedef bool (*agent_trace_func)(void *arg, target_addr addr, size_t len);
+/* Evaluate x on halted target t. Returns 0 and the value left on the
+ * stack in result, -1 on error. trace may be NULL outside tracepoints. */
+int agent_expr_eval(target *t, const struct agent_expr *x, uint64_t *result,
+                    agent_trace_func trace, void *arg);
+/* Like target_breakwatch_set(), with a list of conditions of which one
+ * must be true for a breakpoint hit to be reported. Takes ownership of
+ * cond. Setting an existing breakpoint again replaces its conditions. */
+int target_breakwatch_set_cond(target *t, enum target_breakwatch, target_addr,
+                               size_t, struct agent_expr *cond);
+
+/* Called at a hit of a breakpoint set with target_breakwatch_set_hook(),
+ * with the target halted. Returns true if the halt is to be reported,
+ * otherwise the target resumes at once. Must not change breakpoints. */
+typedef bool (*target_breakwatch_hook)(target *t, void *arg);
+/* Hardware breakpoints for the probe's own use. GDB's z packets don't
+ * remove them and they may share an address with GDB's breakpoints. */
+int target_breakwatch_set_hook(target *t, target_addr addr,
+                               target_breakwatch_hook hook, void *arg);
+int target_breakwatch_clear_hook(target *t, target_addr addr, void *arg);
+
 /* Command interpreter */
 void target_command_help(target *t);
 int target_command(target *t, int argc, const char *argv[]);
@@ -137,6 +172,8 @@ enum target_seek_flag {
 struct target_controller {
 	void (*destroy_callback)(struct target_controller *, target *t);
 	void (*printf)(struct target_controller *, const char *fmt, va_list);
+	/* Console output that may hold any byte, NUL included */
+	void (*console)(struct target_controller *, const char *buf, size_t len);
 
 	/* Interface to host system calls */
 	int (*open)(struct target_controller *,
@@ -164,6 +201,9 @@ struct target_controller {
 	              target_addr cmd, size_t cmd_len);
 	enum target_errno errno_;
 	bool interrupted;
+	/* Set while the host can't serve the system calls above, they then
+	 * fail with TARGET_EBUSY. GDB can't in non-stop mode. */
+	bool no_fileio;
 };
 
 #endif
@@ -20,6 +20,11 @@
 #ifndef __TRACESWO_H
 #define __TRACESWO_H
 
+#if defined(PC_HOSTED)
+bool traceswo_init(uint32_t baudrate, const char *basename);
+void traceswo_stop(void);
+void traceswo_decode(const uint8_t *data, int len);
+#else
 #include <libopencm3/usb/usbd.h>
 
 #if defined TRACESWO_PROTOCOL && TRACESWO_PROTOCOL == 2
@@ -29,5 +34,6 @@ void traceswo_init(void);
 #endif
 
 void trace_buf_drain(usbd_device *dev, uint8_t ep);
+#endif
 
 #endif
@@ -32,9 +32,13 @@
 #include <setjmp.h>
 
 #define PLATFORM_HAS_TRACESWO
+#define PLATFORM_HAS_RTT
 #define BOARD_IDENT "Black Magic Probe (F4Discovery), (Firmware " FIRMWARE_VERSION ")"
 #define DFU_IDENT   "Black Magic Firmware Upgrade (F4Discovery)"
 
+/* The F4 has enough RAM for larger GDB packets */
+#define GDB_PACKET_BUFFER_SIZE 4096
+
 /* Important pin mappings for STM32 implementation:
  *
  * LED0 = 	PD12	(Green  LED : Running)
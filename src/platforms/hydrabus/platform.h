@@ -33,10 +33,14 @@
 #include <setjmp.h>
 
 #define PLATFORM_HAS_TRACESWO
+#define PLATFORM_HAS_RTT
 #define BOARD_IDENT       "Black Magic Probe (HydraBus), (Firmware " FIRMWARE_VERSION ")"
 #define BOARD_IDENT_DFU   "Black Magic (Upgrade) for HydraBus, (Firmware " FIRMWARE_VERSION ")"
 #define DFU_IDENT         "Black Magic Firmware Upgrade (HydraBus)"
 
+/* The F4 has enough RAM for larger GDB packets */
+#define GDB_PACKET_BUFFER_SIZE 4096
+
 /* Important pin mappings for STM32 implementation:
  *
  * LED0 = 	PA4	(Green LED : Running)
@@ -29,6 +29,7 @@
 #include "timing_stm32.h"
 
 #define PLATFORM_HAS_TRACESWO
+#define PLATFORM_HAS_RTT
 #define PLATFORM_HAS_POWER_SWITCH
 #ifdef ENABLE_DEBUG
 #define PLATFORM_HAS_DEBUG
@@ -34,6 +34,8 @@
 
 #define PLATFORM_HAS_DEBUG
 #define PLATFORM_HAS_POWER_SWITCH
+#define PLATFORM_HAS_REMOTE_BATCH
+#define PLATFORM_HAS_RTT
 #define PLATFORM_MAX_MSG_SIZE (256)
 #define PLATFORM_IDENT "PC-HOSTED"
 #define BOARD_IDENT PLATFORM_IDENT
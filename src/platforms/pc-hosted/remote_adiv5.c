@@ -0,0 +1,171 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Batched 32-bit memory accesses executed by the probe.
+ *
+ * Instead of one round trip per SWD bit sequence, up to REMOTE_MAX_BATCH
+ * accesses are sent in one packet and run by the probe's own ADIv5 code.
+ * Firmware older than these packets answers them with E01, the accesses
+ * are then done by the generic ADIv5 code from then on.
+ */
+
+#include <stdio.h>
+
+#include "general.h"
+#include "exception.h"
+#include "remote.h"
+#include "adiv5.h"
+#include "target.h"
+#include "target_internal.h"
+
+/* See remote.c/.h for protocol information */
+
+/* Set once the probe turned down an ADIv5 packet as unrecognised */
+static bool remote_adiv5_unsupported;
+
+/* Send the request in construct and leave the response there. Returns
+ * REMOTE_ERROR_FAULT if the probe reported a fault, and
+ * REMOTE_ERROR_UNRECOGNISED if its firmware lacks the ADIv5 packets. */
+static int remote_adiv5_exchange(ADIv5_AP_t *ap, char *construct, int s)
+{
+  platform_buffer_write((uint8_t *)construct,s);
+
+  s=platform_buffer_read((uint8_t *)construct, PLATFORM_MAX_MSG_SIZE);
+  if ((s>1) && (construct[0]==REMOTE_RESP_ERR))
+    {
+      uint64_t err=remotehston(-1,&construct[1]);
+      if (err==REMOTE_ERROR_FAULT)
+        {
+          ap->dp->fault=1;
+          return REMOTE_ERROR_FAULT;
+        }
+      if (err==REMOTE_ERROR_UNRECOGNISED)
+        {
+          DEBUG("Probe firmware has no ADIv5 batches, using single accesses\n");
+          remote_adiv5_unsupported=true;
+          return REMOTE_ERROR_UNRECOGNISED;
+        }
+    }
+  if ((s<1) || (construct[0]!=REMOTE_RESP_OK))
+    {
+      DEBUG("remote ADIv5 request failed, error %s\n",s?&(construct[1]):"short response");
+      raise_exception(EXCEPTION_ERROR, "Remote ADIv5 request failed");
+    }
+  return 0;
+}
+
+/* Hand the DP over to the generic ADIv5 code for good. Returns true if
+ * the probe can't run the ADIv5 packets. */
+static bool remote_adiv5_fallback(ADIv5_AP_t *ap)
+{
+  if (!remote_adiv5_unsupported)
+    return false;
+  ap->dp->mem_read32_batch=NULL;
+  ap->dp->mem_write32_batch=NULL;
+  ap->dp->mem_poll32=NULL;
+  return true;
+}
+
+/* Returns 0 when done, otherwise the error from remote_adiv5_exchange() */
+static int remote_mem32_batch(ADIv5_AP_t *ap, struct target_mem32 *rops,
+                              const struct target_mem32 *wops, size_t n)
+{
+  int err;
+  char construct[PLATFORM_MAX_MSG_SIZE];
+  int s;
+
+  s=snprintf(construct,PLATFORM_MAX_MSG_SIZE,
+             wops?REMOTE_MEM_WRITE32_STR:REMOTE_MEM_READ32_STR,
+             ap->apsel,ap->csw,(int)n);
+  for (size_t i=0; i<n; i++)
+    {
+      if (wops)
+        s+=snprintf(&construct[s],PLATFORM_MAX_MSG_SIZE-s,"%08" PRIx32 "%08" PRIx32,
+                    wops[i].addr,wops[i].value);
+      else
+        s+=snprintf(&construct[s],PLATFORM_MAX_MSG_SIZE-s,"%08" PRIx32,rops[i].addr);
+    }
+  s+=snprintf(&construct[s],PLATFORM_MAX_MSG_SIZE-s,"%c",REMOTE_EOM);
+  if ((err=remote_adiv5_exchange(ap,construct,s)))
+    return err;
+  for (size_t i=0; rops && (i<n); i++)
+    rops[i].value=remotehston(8,&construct[1+i*8]);
+  return 0;
+}
+
+void remote_mem_read32_batch(ADIv5_AP_t *ap, struct target_mem32 *ops, size_t n)
+{
+  while (n && !remote_adiv5_unsupported)
+    {
+      size_t chunk=MIN(n,REMOTE_MAX_BATCH);
+      int err=remote_mem32_batch(ap,ops,NULL,chunk);
+      if (err==REMOTE_ERROR_FAULT)
+        return;
+      if (err)
+        break;
+      ops+=chunk;
+      n-=chunk;
+    }
+  if (n && remote_adiv5_fallback(ap))
+    adiv5_mem_read32_batch(ap,ops,n);
+}
+
+void remote_mem_write32_batch(ADIv5_AP_t *ap, const struct target_mem32 *ops, size_t n)
+{
+  while (n && !remote_adiv5_unsupported)
+    {
+      size_t chunk=MIN(n,REMOTE_MAX_BATCH);
+      int err=remote_mem32_batch(ap,NULL,ops,chunk);
+      if (err==REMOTE_ERROR_FAULT)
+        return;
+      if (err)
+        break;
+      ops+=chunk;
+      n-=chunk;
+    }
+  if (n && remote_adiv5_fallback(ap))
+    adiv5_mem_write32_batch(ap,ops,n);
+}
+
+bool remote_mem_poll32(ADIv5_AP_t *ap, uint32_t addr, uint32_t mask,
+                       uint32_t value, uint32_t timeout_ms, uint32_t *result)
+{
+  char construct[PLATFORM_MAX_MSG_SIZE];
+  platform_timeout timeout;
+  uint32_t val=0;
+  bool done=false;
+
+  platform_timeout_set(&timeout, timeout_ms);
+  while (!remote_adiv5_unsupported)
+    {
+      int s=snprintf(construct,PLATFORM_MAX_MSG_SIZE,REMOTE_MEM_POLL32_STR,
+                     ap->apsel,ap->csw,addr,mask,value,
+                     (unsigned)MIN(timeout_ms,REMOTE_MAX_POLL_MS));
+      if (remote_adiv5_exchange(ap,construct,s))
+        break;
+      val=remotehston(8,&construct[1]);
+      done=((val & mask)==value);
+      if (done || platform_timeout_is_expired(&timeout))
+        break;
+    }
+  if (remote_adiv5_fallback(ap))
+    return adiv5_mem_poll32(ap,addr,mask,value,timeout_ms,result);
+  *result=val;
+  return done;
+}
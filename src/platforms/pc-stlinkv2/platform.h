@@ -34,6 +34,9 @@
 #endif
 
 #define PLATFORM_HAS_DEBUG
+#define PLATFORM_HAS_TRACESWO
+#define TRACESWO_PROTOCOL 2 /* NRZ / async */
+#define PLATFORM_HAS_RTT
 
 #define PLATFORM_IDENT "StlinkV2/3"
 #define SET_RUN_STATE(state)
@@ -29,12 +29,16 @@
 #include "adiv5.h"
 #include "stlinkv2.h"
 #include "exception.h"
+#include "traceswo.h"
+#include "target.h"
+#include "target_internal.h"
 
 #include <assert.h>
 #include <unistd.h>
 #include <signal.h>
 #include <ctype.h>
 #include <sys/time.h>
+#include <pthread.h>
 
 #include "cl_utils.h"
 
@@ -312,28 +316,34 @@ static void LIBUSB_CALL on_trans_done(struct libusb_transfer * trans)
     ctx->flags |= TRANS_FLAGS_IS_DONE;
 }
 
-static int submit_wait(struct libusb_transfer * trans) {
-	struct timeval start;
-	struct timeval now;
-	struct timeval diff;
-	struct trans_ctx trans_ctx;
+static void submit(struct libusb_transfer * trans,
+				   struct trans_ctx *trans_ctx)
+{
 	enum libusb_error error;
 
-	trans_ctx.flags = 0;
+	trans_ctx->flags = 0;
 
 	/* brief intrusion inside the libusb interface */
 	trans->callback = on_trans_done;
-	trans->user_data = &trans_ctx;
+	trans->user_data = trans_ctx;
 
 	if ((error = libusb_submit_transfer(trans))) {
 		DEBUG("libusb_submit_transfer(%d): %s\n", error,
 			  libusb_strerror(error));
 		exit(-1);
 	}
+}
+
+static int wait_done(struct libusb_transfer * trans,
+					 struct trans_ctx *trans_ctx)
+{
+	struct timeval start;
+	struct timeval now;
+	struct timeval diff;
 
 	gettimeofday(&start, NULL);
 
-	while (trans_ctx.flags == 0) {
+	while (trans_ctx->flags == 0) {
 		struct timeval timeout;
 		timeout.tv_sec = 1;
 		timeout.tv_usec = 0;
@@ -351,13 +361,96 @@ static int submit_wait(struct libusb_transfer * trans) {
 		}
 	}
 
-	if (trans_ctx.flags & TRANS_FLAGS_HAS_ERROR) {
+	if (trans_ctx->flags & TRANS_FLAGS_HAS_ERROR) {
 		DEBUG("libusb_handle_events() | has_error\n");
 		return -1;
 	}
 
 	return 0;
 }
+
+static int submit_wait(struct libusb_transfer * trans)
+{
+	struct trans_ctx trans_ctx;
+	submit(trans, &trans_ctx);
+	return wait_done(trans, &trans_ctx);
+}
+
+/* Pipelined transfers.
+ *
+ * Command, data and reply phases are queued without waiting for each
+ * other. Completed transfers are reaped in submission order, either when
+ * a slot is needed again or on pipe_flush().*/
+#define PIPE_DEPTH 16
+
+static struct {
+	struct libusb_transfer *trans[PIPE_DEPTH];
+	struct trans_ctx ctx[PIPE_DEPTH];
+	uint8_t cmd[PIPE_DEPTH][16];
+	uint8_t ep[PIPE_DEPTH];
+	int head;
+	int pending;
+	bool error;
+} pipe_q;
+
+static void pipe_reap(void)
+{
+	int tail = (pipe_q.head + PIPE_DEPTH - pipe_q.pending) % PIPE_DEPTH;
+	if (wait_done(pipe_q.trans[tail], &pipe_q.ctx[tail])) {
+		DEBUG_USB("clear %d\n", pipe_q.ep[tail] & 0x7f);
+		libusb_clear_halt(Stlink.handle, pipe_q.ep[tail] & 0x7f);
+		pipe_q.error = true;
+	}
+	pipe_q.pending--;
+}
+
+static void pipe_submit(uint8_t ep, uint8_t *buf, size_t size)
+{
+	stlink_check_detach(1);
+	if (pipe_q.pending == PIPE_DEPTH)
+		pipe_reap();
+	int slot = pipe_q.head;
+	if (!pipe_q.trans[slot])
+		pipe_q.trans[slot] = libusb_alloc_transfer(0);
+	pipe_q.ep[slot] = ep;
+	libusb_fill_bulk_transfer(pipe_q.trans[slot], Stlink.handle, ep,
+							  buf, size, NULL, NULL, 0);
+	DEBUG_USB("  Queue %s (%zu)\n", (ep & LIBUSB_ENDPOINT_IN) ? "IN" : "OUT",
+			  size);
+	submit(pipe_q.trans[slot], &pipe_q.ctx[slot]);
+	pipe_q.head = (slot + 1) % PIPE_DEPTH;
+	pipe_q.pending++;
+}
+
+/* Queue txsize bytes from txbuf for the OUT endpoint. Buffers up to
+ * 16 bytes are copied, larger ones must stay valid until pipe_flush().*/
+static void pipe_send(const uint8_t *txbuf, size_t txsize)
+{
+	uint8_t *buf = (uint8_t *)txbuf;
+	if (pipe_q.pending == PIPE_DEPTH) /* Slot buffer may still be in use */
+		pipe_reap();
+	if (txsize <= sizeof(pipe_q.cmd[pipe_q.head])) {
+		memcpy(pipe_q.cmd[pipe_q.head], txbuf, txsize);
+		buf = pipe_q.cmd[pipe_q.head];
+	}
+	pipe_submit(Stlink.ep_tx | LIBUSB_ENDPOINT_OUT, buf, txsize);
+}
+
+/* Queue a read of rxsize bytes into rxbuf, valid after pipe_flush().*/
+static void pipe_recv(uint8_t *rxbuf, size_t rxsize)
+{
+	pipe_submit(0x01 | LIBUSB_ENDPOINT_IN, rxbuf, rxsize);
+}
+
+/* Wait for all queued transfers, return -1 if any of them failed.*/
+static int pipe_flush(void)
+{
+	while (pipe_q.pending)
+		pipe_reap();
+	int res = pipe_q.error ? -1 : 0;
+	pipe_q.error = false;
+	return res;
+}
 #define STLINK_ERROR_DP_FAULT -2
 static int send_recv(uint8_t *txbuf, size_t txsize,
 					 uint8_t *rxbuf, size_t rxsize)
@@ -1189,29 +1282,53 @@ int stlink_usb_get_rw_status(void)
 	return stlink_usb_error_check(data, true);
 }
 
-void stlink_readmem(ADIv5_AP_t *ap, void *dest, uint32_t src, size_t len)
+/* The ST-Link increments TAR only inside a 1 kiB window, so a bulk
+ * command must not cross such a boundary.*/
+#define STLINK_TAR_AUTOINCR_BLOCK 0x400
+
+/* Find the largest chunk at addr that one bulk command can transfer with
+ * an access width no larger than max_width. Unaligned heads and short
+ * tails are handed out as 8- or 16-bit chunks, the rest as 32-bit ones.*/
+static size_t stlink_chunk(uint32_t addr, size_t len, int max_width,
+						   int *width)
+{
+	size_t chunk;
+	if ((max_width >= 4) && !(addr & 3) && (len >= 4)) {
+		*width = 4;
+		chunk = len & ~3;
+	} else if ((max_width >= 2) && !(addr & 1) && (len >= 2)) {
+		*width = 2;
+		chunk = (max_width == 2) ? (len & ~1) : 2;
+	} else {
+		*width = 1;
+		chunk = len;
+		if ((max_width >= 2) && (addr & 3))
+			chunk = MIN(len, 4 - (addr & 3));
+		if (chunk > Stlink.block_size)
+			chunk = Stlink.block_size;
+	}
+	size_t to_boundary = STLINK_TAR_AUTOINCR_BLOCK -
+		(addr & (STLINK_TAR_AUTOINCR_BLOCK - 1));
+	return MIN(chunk, to_boundary);
+}
+
+static int stlink_readmem_chunk(ADIv5_AP_t *ap, uint8_t *dest, uint32_t src,
+								size_t len, int width)
 {
-	if (len == 0)
-		return;
-	size_t read_len = len;
 	uint8_t type;
 	char *CMD;
-	if (src & 1 || len & 1) {
+	switch (width) {
+	case 1:
 		CMD = "READMEM_8BIT";
 		type = STLINK_DEBUG_READMEM_8BIT;
-		if (len > Stlink.block_size) {
-			DEBUG(" Too large!\n");
-			return;
-		}
-		if (len == 1)
-			read_len ++; /* Fix read length as in openocd*/
-	} else if (src & 3 || len & 3) {
+		break;
+	case 2:
 		CMD = "READMEM_16BIT";
 		type = STLINK_DEBUG_APIV2_READMEM_16BIT;
-	} else {
+		break;
+	default:
 		CMD = "READMEM_32BIT";
 		type = STLINK_DEBUG_READMEM_32BIT;
-
 	}
 	DEBUG_STLINK("%s len %zu addr 0x%08" PRIx32 " AP %d : ",
 				 CMD, len, src, ap->apsel);
@@ -1221,90 +1338,268 @@ void stlink_readmem(ADIv5_AP_t *ap, void *dest, uint32_t src, size_t len)
 		src & 0xff, (src >>  8) & 0xff, (src >> 16) & 0xff,
 		(src >> 24) & 0xff,
 		len & 0xff, len >> 8, ap->apsel};
-	int res = read_retry(cmd, 16, dest, read_len);
-	if (res == STLINK_ERROR_OK) {
-		uint8_t *p = (uint8_t*)dest;
-		for (size_t i = 0; i < len ; i++) {
-			DEBUG_STLINK("%02x", *p++);
-		}
+	int res;
+	if (len == 1) {
+		/* Fix read length as in openocd*/
+		uint8_t data[2];
+		res = read_retry(cmd, 16, data, 2);
+		dest[0] = data[0];
 	} else {
-		/* FIXME: What is the right measure when failing?
-		 *
-		 * E.g. TM4C129 gets here when NRF probe reads 0x10000010
-		 * Approach taken:
-		 * Fill the memory with some fixed pattern so hopefully
-		 * the caller notices the error*/
-		DEBUG("stlink_readmem failed\n");
-		memset(dest, 0xff, len);
+		res = read_retry(cmd, 16, dest, len);
+	}
+	if (res == STLINK_ERROR_OK) {
+		for (size_t i = 0; i < len ; i++)
+			DEBUG_STLINK("%02x", dest[i]);
 	}
 	DEBUG_STLINK("\n");
+	return res;
+}
+
+void stlink_readmem(ADIv5_AP_t *ap, void *dest, uint32_t src, size_t len)
+{
+	uint8_t *p = (uint8_t*)dest;
+	while (len) {
+		int width;
+		size_t chunk = stlink_chunk(src, len, 4, &width);
+		if (stlink_readmem_chunk(ap, p, src, chunk, width)) {
+			/* FIXME: What is the right measure when failing?
+			 *
+			 * E.g. TM4C129 gets here when NRF probe reads 0x10000010
+			 * Approach taken:
+			 * Fill the memory with some fixed pattern so hopefully
+			 * the caller notices the error*/
+			DEBUG("stlink_readmem failed at 0x%08" PRIx32 "\n", src);
+			memset(p, 0xff, len);
+			return;
+		}
+		p += chunk;
+		src += chunk;
+		len -= chunk;
+	}
 }
 
-void stlink_writemem8(ADIv5_AP_t *ap, uint32_t addr, size_t len,
-					  uint8_t *buffer)
+static void stlink_writemem_cmd(uint8_t *cmd, ADIv5_AP_t *ap, uint32_t addr,
+								size_t len, int width)
 {
-	DEBUG_STLINK("Mem Write8 AP %d len %zu addr 0x%08" PRIx32 ": ",
-				 ap->apsel, len, addr);
+	uint8_t type;
+	switch (width) {
+	case 1:
+		type = STLINK_DEBUG_WRITEMEM_8BIT;
+		break;
+	case 2:
+		type = STLINK_DEBUG_APIV2_WRITEMEM_16BIT;
+		break;
+	default:
+		type = STLINK_DEBUG_WRITEMEM_32BIT;
+	}
+	memset(cmd, 0, 16);
+	cmd[0] = STLINK_DEBUG_COMMAND;
+	cmd[1] = type;
+	cmd[2] = addr & 0xff;
+	cmd[3] = (addr >>  8) & 0xff;
+	cmd[4] = (addr >> 16) & 0xff;
+	cmd[5] = (addr >> 24) & 0xff;
+	cmd[6] = len & 0xff;
+	cmd[7] = len >> 8;
+	cmd[8] = ap->apsel;
+}
+
+static int stlink_writemem_chunk(ADIv5_AP_t *ap, uint32_t addr,
+								 const uint8_t *buffer, size_t len, int width)
+{
+	DEBUG_STLINK("Mem Write%d AP %d len %zu addr 0x%08" PRIx32 ": ",
+				 width * 8, ap->apsel, len, addr);
 	for (size_t t = 0; t < len; t++) {
 		DEBUG_STLINK("%02x", buffer[t]);
 	}
 	DEBUG_STLINK("\n");
-	while (len) {
-		size_t length;
-		if (len > Stlink.block_size)
-			length = Stlink.block_size;
-		else
-			length = len;
-		uint8_t cmd[16] = {
-			STLINK_DEBUG_COMMAND,
-			STLINK_DEBUG_WRITEMEM_8BIT,
-			addr & 0xff, (addr >>  8) & 0xff, (addr >> 16) & 0xff,
-			(addr >> 24) & 0xff,
-			length & 0xff, length >> 8, ap->apsel};
-		send_recv(cmd, 16, NULL, 0);
-		send_recv((void*)buffer, length, NULL, 0);
-		stlink_usb_get_rw_status();
-		len -= length;
-		addr += length;
+	uint8_t cmd[16];
+	stlink_writemem_cmd(cmd, ap, addr, len, width);
+	return write_retry(cmd, 16, (void*)buffer, len);
+}
+
+/* Number of chunks streamed before waiting for the adapter.*/
+#define STLINK_WRITE_BATCH 16
+
+/* Only writes to the SRAM and external RAM regions of the ARMv7-M memory
+ * map are streamed. Chunks after one that got a WAIT have landed already,
+ * so streamed writes are not in program order and may be done twice.
+ * Peripherals and flash programmed with plain writes need both. */
+static bool stlink_write_streamable(uint32_t addr, size_t len)
+{
+	uint32_t last = addr + len - 1;
+	return (last >= addr) &&
+		(((addr >= 0x20000000) && (last < 0x40000000)) ||
+		 ((addr >= 0x60000000) && (last < 0xa0000000)));
+}
+
+/* Stream up to STLINK_WRITE_BATCH chunks, each followed by a R/W status
+ * query, so the status of every chunk is known. At the first chunk that
+ * got a WAIT the batch ends, and writing goes on from that chunk.
+ * Returns the number of bytes written in done, and -1 if a chunk
+ * failed.*/
+static int stlink_writemem_batch(ADIv5_AP_t *ap, uint32_t addr,
+								 const uint8_t *p, size_t len,
+								 int max_width, size_t *done)
+{
+	uint8_t status[STLINK_WRITE_BATCH][12];
+	size_t chunks[STLINK_WRITE_BATCH];
+	int widths[STLINK_WRITE_BATCH];
+	uint8_t stat_cmd[16] = {
+		STLINK_DEBUG_COMMAND,
+		STLINK_DEBUG_APIV2_GETLASTRWSTATUS2
+	};
+	int n = 0;
+	*done = 0;
+	for (; (n < STLINK_WRITE_BATCH) && (*done < len); n++) {
+		chunks[n] = stlink_chunk(addr + *done, len - *done, max_width,
+								 &widths[n]);
+		uint8_t cmd[16];
+		stlink_writemem_cmd(cmd, ap, addr + *done, chunks[n], widths[n]);
+		DEBUG_STLINK("Mem Write%d AP %d len %zu addr 0x%08" PRIx32
+					 " queued\n", widths[n] * 8, ap->apsel, chunks[n],
+					 (uint32_t)(addr + *done));
+		pipe_send(cmd, 16);
+		pipe_send(p + *done, chunks[n]);
+		pipe_send(stat_cmd, 16);
+		pipe_recv(status[n], 12);
+		*done += chunks[n];
+	}
+	/* Nothing is known about the chunks after a USB error */
+	if (pipe_flush())
+		return -1;
+	*done = 0;
+	for (int i = 0; i < n; i++) {
+		int res = stlink_usb_error_check(status[i], true);
+		if ((res == STLINK_ERROR_WAIT) && (i > 0))
+			return 0;
+		/* Retry a first chunk with WAIT on its own, so a busy AP
+		 * can't make a batch loop forever */
+		if (res == STLINK_ERROR_WAIT)
+			res = stlink_writemem_chunk(ap, addr, p, chunks[i], widths[i]);
+		if (res != STLINK_ERROR_OK) {
+			DEBUG("stlink_writemem failed at 0x%08" PRIx32 "\n", addr);
+			return -1;
+		}
+		p += chunks[i];
+		addr += chunks[i];
+		*done += chunks[i];
 	}
+	return 0;
 }
 
-void stlink_writemem16(ADIv5_AP_t *ap, uint32_t addr, size_t len,
-					   uint16_t *buffer)
+void stlink_writemem(ADIv5_AP_t *ap, uint32_t addr, const void *src,
+					 size_t len, enum align align)
 {
-	DEBUG_STLINK("Mem Write16 AP %d len %zu addr 0x%08" PRIx32 ": ",
-				 ap->apsel, len, addr);
-	for (size_t t = 0; t < len; t+=2) {
-		DEBUG_STLINK("%04x", buffer[t]);
+	const uint8_t *p = (const uint8_t*)src;
+	int max_width = (align > ALIGN_WORD) ? 4 : 1 << align;
+	bool stream = stlink_write_streamable(addr, len);
+	while (len) {
+		size_t done;
+		if (!stream) {
+			int width;
+			done = stlink_chunk(addr, len, max_width, &width);
+			if (stlink_writemem_chunk(ap, addr, p, done, width)) {
+				DEBUG("stlink_writemem failed at 0x%08" PRIx32 "\n",
+				      addr);
+				return;
+			}
+		} else if (stlink_writemem_batch(ap, addr, p, len, max_width,
+		                                 &done)) {
+			return;
+		}
+		p += done;
+		addr += done;
+		len -= done;
 	}
-	DEBUG_STLINK("\n");
-	uint8_t cmd[16] = {
+}
+
+/* Execute up to STLINK_WRITE_BATCH word accesses with all commands in
+ * flight. Reads check the status once. Writes are mostly side-effecting
+ * register sequences that must not be replayed, their status is queried
+ * after every access. Returns the number of accesses done, or 0 if reads
+ * have to be replayed one by one or a write failed.*/
+static size_t stlink_mem32_batch(ADIv5_AP_t *ap, struct target_mem32 *rops,
+								 const struct target_mem32 *wops, size_t n)
+{
+	uint8_t data[STLINK_WRITE_BATCH][4];
+	uint8_t status[STLINK_WRITE_BATCH][12];
+	uint8_t stat_cmd[16] = {
 		STLINK_DEBUG_COMMAND,
-		STLINK_DEBUG_APIV2_WRITEMEM_16BIT,
-		addr & 0xff, (addr >>  8) & 0xff, (addr >> 16) & 0xff,
-		(addr >> 24) & 0xff,
-		len & 0xff, len >> 8, ap->apsel};
-	send_recv(cmd, 16, NULL, 0);
-	send_recv((void*)buffer, len, NULL, 0);
-	stlink_usb_get_rw_status();
+		STLINK_DEBUG_APIV2_GETLASTRWSTATUS2
+	};
+	n = MIN(n, STLINK_WRITE_BATCH);
+	for (size_t i = 0; i < n; i++) {
+		uint8_t cmd[16];
+		if (wops) {
+			uint32_t val = wops[i].value;
+			stlink_writemem_cmd(cmd, ap, wops[i].addr, 4, 4);
+			data[i][0] = val & 0xff;
+			data[i][1] = (val >>  8) & 0xff;
+			data[i][2] = (val >> 16) & 0xff;
+			data[i][3] = (val >> 24) & 0xff;
+			pipe_send(cmd, 16);
+			pipe_send(data[i], 4);
+			pipe_send(stat_cmd, 16);
+			pipe_recv(status[i], 12);
+		} else {
+			stlink_writemem_cmd(cmd, ap, rops[i].addr, 4, 4);
+			cmd[1] = STLINK_DEBUG_READMEM_32BIT;
+			pipe_send(cmd, 16);
+			pipe_recv(data[i], 4);
+		}
+	}
+	if (pipe_flush())
+		return 0;
+	/* The accesses after a failed one went through already. Retrying
+	 * it would change the order of e.g. a key sequence, so the caller
+	 * gets the error instead. */
+	for (size_t i = 0; wops && (i < n); i++)
+		if (stlink_usb_error_check(status[i], true) != STLINK_ERROR_OK) {
+			DEBUG("stlink_mem_write32_batch failed at 0x%08" PRIx32 "\n",
+				  wops[i].addr);
+			return 0;
+		}
+	if (rops && (stlink_usb_get_rw_status() != STLINK_ERROR_OK))
+		return 0;
+	for (size_t i = 0; rops && (i < n); i++) {
+		rops[i].value = data[i][0] | data[i][1] << 8 | data[i][2] << 16 |
+			data[i][3] << 24;
+		DEBUG_STLINK("Mem Read32 AP %d addr 0x%08" PRIx32 ": 0x%08" PRIx32
+					 "\n", ap->apsel, rops[i].addr, rops[i].value);
+	}
+	return n;
 }
 
-void stlink_writemem32(ADIv5_AP_t *ap, uint32_t addr, size_t len,
-					   uint32_t *buffer)
+void stlink_mem_read32_batch(ADIv5_AP_t *ap, struct target_mem32 *ops,
+							 size_t n)
 {
-	DEBUG_STLINK("Mem Write32 AP %d len %zu addr 0x%08" PRIx32 ": ",
-				 ap->apsel, len, addr);
-	for (size_t t = 0; t < len; t+=4) {
-		DEBUG_STLINK("%04x", buffer[t]);
+	while (n) {
+		size_t done = stlink_mem32_batch(ap, ops, NULL, n);
+		if (!done) {
+			DEBUG("stlink_mem_read32_batch failed, reading one by one\n");
+			done = MIN(n, STLINK_WRITE_BATCH);
+			for (size_t i = 0; i < done; i++)
+				stlink_readmem(ap, &ops[i].value, ops[i].addr, 4);
+		}
+		ops += done;
+		n -= done;
+	}
+}
+
+void stlink_mem_write32_batch(ADIv5_AP_t *ap, const struct target_mem32 *ops,
+							  size_t n)
+{
+	while (n) {
+		size_t done = stlink_mem32_batch(ap, NULL, ops, n);
+		if (!done) {
+			/* Reported through stlink_dp_error() */
+			Stlink.ap_error = true;
+			return;
+		}
+		ops += done;
+		n -= done;
 	}
-	DEBUG_STLINK("\n");
-	uint8_t cmd[16] = {
-		STLINK_DEBUG_COMMAND,
-		STLINK_DEBUG_WRITEMEM_32BIT,
-		addr & 0xff, (addr >>  8) & 0xff, (addr >> 16) & 0xff,
-		(addr >> 24) & 0xff,
-		len & 0xff, len >> 8, ap->apsel};
-	write_retry(cmd, 16, (void*)buffer, len);
 }
 
 void stlink_regs_read(ADIv5_AP_t *ap, void *data)
@@ -1325,7 +1620,7 @@ uint32_t stlink_reg_read(ADIv5_AP_t *ap, int num)
 	uint8_t res[8];
 	send_recv(cmd, 16, res, 8);
 	stlink_usb_error_check(res, true);
-	uint32_t ret = res[0] | res[1] << 8 | res[2] << 16 | res[3] << 24;
+	uint32_t ret = res[4] | res[5] << 8 | res[6] << 16 | res[7] << 24;
 	DEBUG_STLINK("AP %d: Read reg %02" PRId32 " val 0x%08" PRIx32 "\n",
 				 ap->apsel, num, ret);
 	return ret;
@@ -1344,6 +1639,176 @@ void stlink_reg_write(ADIv5_AP_t *ap, int num, uint32_t val)
 	stlink_usb_error_check(res, true);
 }
 
+/* Read n registers with all READREG requests in flight at once.*/
+void stlink_regs_read_list(ADIv5_AP_t *ap, const uint32_t *regnum, int n,
+						   uint32_t *data)
+{
+	uint8_t res[n][8];
+	for (int i = 0; i < n; i++) {
+		uint8_t cmd[16] = {STLINK_DEBUG_COMMAND, STLINK_DEBUG_APIV2_READREG,
+						   regnum[i], ap->apsel};
+		pipe_send(cmd, 16);
+		pipe_recv(res[i], 8);
+	}
+	if (pipe_flush()) {
+		DEBUG("stlink_regs_read_list failed, reading one by one\n");
+		for (int i = 0; i < n; i++)
+			data[i] = stlink_reg_read(ap, regnum[i]);
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		stlink_usb_error_check(res[i], true);
+		data[i] = res[i][4] | res[i][5] << 8 | res[i][6] << 16 |
+			res[i][7] << 24;
+		DEBUG_STLINK("AP %d: Read reg %02" PRId32 " val 0x%08" PRIx32 "\n",
+					 ap->apsel, regnum[i], data[i]);
+	}
+}
+
+/* Write n registers with all WRITEREG requests in flight at once.*/
+void stlink_regs_write_list(ADIv5_AP_t *ap, const uint32_t *regnum, int n,
+							const uint32_t *data)
+{
+	uint8_t res[n][2];
+	for (int i = 0; i < n; i++) {
+		uint32_t val = data[i];
+		uint8_t cmd[16] = {
+			STLINK_DEBUG_COMMAND, STLINK_DEBUG_APIV2_WRITEREG, regnum[i],
+			val & 0xff, (val >>  8) & 0xff, (val >> 16) & 0xff,
+			(val >> 24) & 0xff, ap->apsel};
+		DEBUG_STLINK("AP %d: Write reg %02" PRId32 " val 0x%08" PRIx32 "\n",
+					 ap->apsel, regnum[i], val);
+		pipe_send(cmd, 16);
+		pipe_recv(res[i], 2);
+	}
+	if (pipe_flush()) {
+		DEBUG("stlink_regs_write_list failed, writing one by one\n");
+		for (int i = 0; i < n; i++)
+			stlink_reg_write(ap, regnum[i], data[i]);
+		return;
+	}
+	for (int i = 0; i < n; i++)
+		stlink_usb_error_check(res[i], true);
+}
+
+/* SWO trace capture.
+ *
+ * The adapter collects SWO data (NRZ) into a STLINK_TRACE_SIZE buffer
+ * and hands it out on its trace endpoint. Two IN transfers are kept
+ * queued on that endpoint and pass the data on to the ITM decoder in
+ * traceswo.c. Transfers only complete while libusb events are handled,
+ * so a thread keeps handling them while capture runs. Otherwise the
+ * adapter's buffer would overflow whenever the main loop waits for GDB.
+ * libusb runs one event handler at a time, so callbacks never run
+ * concurrently with those of the adapter accesses.*/
+#define STLINK_TRACE_TRANSFERS 2
+/* Longest wait of the trace thread for an event */
+#define STLINK_TRACE_POLL_US 100000
+
+static struct {
+	bool enabled;
+	int pending;
+	struct libusb_transfer *trans[STLINK_TRACE_TRANSFERS];
+	uint8_t buf[STLINK_TRACE_TRANSFERS][STLINK_TRACE_SIZE];
+	pthread_t thread;
+	bool thread_running;
+	int thread_stop;
+} trace;
+
+static void *stlink_trace_thread(void *arg)
+{
+	(void)arg;
+	while (!trace.thread_stop) {
+		struct timeval timeout = {0, STLINK_TRACE_POLL_US};
+		libusb_handle_events_timeout_completed(Stlink.libusb_ctx, &timeout,
+											   &trace.thread_stop);
+	}
+	return NULL;
+}
+
+static void LIBUSB_CALL on_trace_done(struct libusb_transfer *trans)
+{
+	if (trans->status == LIBUSB_TRANSFER_COMPLETED && trans->actual_length)
+		traceswo_decode(trans->buffer, trans->actual_length);
+	if (trace.enabled && ((trans->status == LIBUSB_TRANSFER_COMPLETED) ||
+						  (trans->status == LIBUSB_TRANSFER_TIMED_OUT)) &&
+		!libusb_submit_transfer(trans))
+		return;
+	trace.pending--;
+}
+
+int stlink_trace_start(uint32_t baudrate)
+{
+	if (baudrate > STLINK_TRACE_MAX_HZ) {
+		DEBUG("Baudrate %" PRIu32 " too high, max %d\n", baudrate,
+			  STLINK_TRACE_MAX_HZ);
+		return -1;
+	}
+	if (trace.enabled)
+		stlink_trace_stop();
+	uint8_t cmd[16] = {
+		STLINK_DEBUG_COMMAND,
+		STLINK_DEBUG_APIV2_START_TRACE_RX,
+		STLINK_TRACE_SIZE & 0xff, STLINK_TRACE_SIZE >> 8,
+		baudrate & 0xff, (baudrate >> 8) & 0xff, (baudrate >> 16) & 0xff,
+		(baudrate >> 24) & 0xff};
+	uint8_t data[2];
+	send_recv(cmd, 16, data, 2);
+	DEBUG_STLINK("Start trace, baudrate %" PRIu32 "\n", baudrate);
+	if (stlink_usb_error_check(data, true))
+		return -1;
+	/* Trace data arrives on endpoint 3 on V2 and endpoint 2 on V3*/
+	uint8_t ep = ((Stlink.ver_hw == 30) ? 2 : 3) | LIBUSB_ENDPOINT_IN;
+	trace.enabled = true;
+	for (int i = 0; i < STLINK_TRACE_TRANSFERS; i++) {
+		if (!trace.trans[i])
+			trace.trans[i] = libusb_alloc_transfer(0);
+		libusb_fill_bulk_transfer(trace.trans[i], Stlink.handle, ep,
+								  trace.buf[i], STLINK_TRACE_SIZE,
+								  on_trace_done, NULL, 0);
+		if (libusb_submit_transfer(trace.trans[i])) {
+			DEBUG("Can not submit trace transfer\n");
+			stlink_trace_stop();
+			return -1;
+		}
+		trace.pending++;
+	}
+	trace.thread_stop = 0;
+	if (pthread_create(&trace.thread, NULL, stlink_trace_thread, NULL)) {
+		DEBUG("Can not start trace thread\n");
+		stlink_trace_stop();
+		return -1;
+	}
+	trace.thread_running = true;
+	return 0;
+}
+
+void stlink_trace_stop(void)
+{
+	trace.enabled = false;
+	if (trace.thread_running) {
+		/* The thread notices within STLINK_TRACE_POLL_US */
+		trace.thread_stop = 1;
+		pthread_join(trace.thread, NULL);
+		trace.thread_running = false;
+	}
+	for (int i = 0; i < STLINK_TRACE_TRANSFERS; i++)
+		if (trace.trans[i])
+			libusb_cancel_transfer(trace.trans[i]);
+	while (trace.pending) {
+		struct timeval timeout = {1, 0};
+		if (libusb_handle_events_timeout(Stlink.libusb_ctx, &timeout))
+			break;
+	}
+	uint8_t cmd[16] = {
+		STLINK_DEBUG_COMMAND,
+		STLINK_DEBUG_APIV2_STOP_TRACE_RX};
+	uint8_t data[2];
+	send_recv(cmd, 16, data, 2);
+	DEBUG_STLINK("Stop trace\n");
+	stlink_usb_error_check(data, true);
+}
+
 void
 adiv5_mem_read(ADIv5_AP_t *ap, void *dest, uint32_t src, size_t len)
 {
@@ -1356,16 +1821,58 @@ adiv5_mem_write_sized(ADIv5_AP_t *ap, uint32_t dest, const void *src,
 {
 	if (len == 0)
 		return;
-	switch(align) {
-	case ALIGN_BYTE: stlink_writemem8(ap, dest, len, (uint8_t *) src);
-		break;
-	case ALIGN_HALFWORD: stlink_writemem16(ap, dest, len, (uint16_t *) src);
-		break;
-	case ALIGN_WORD: stlink_writemem32(ap, dest, len, (uint32_t *) src);
-		break;
-	case ALIGN_DWORD: stlink_writemem32(ap, dest, len, (uint32_t *) src);
-		break;
-	}
+	stlink_writemem(ap, dest, src, len, align);
+}
+
+void adiv5_mem_read32_batch(ADIv5_AP_t *ap, struct target_mem32 *ops,
+							size_t n)
+{
+	stlink_mem_read32_batch(ap, ops, n);
+}
+
+void adiv5_mem_write32_batch(ADIv5_AP_t *ap, const struct target_mem32 *ops,
+							 size_t n)
+{
+	stlink_mem_write32_batch(ap, ops, n);
+}
+
+/* The adapter has no polling command. Each read is pipelined with its
+ * status request, so one poll costs a single round trip.*/
+bool adiv5_mem_poll32(ADIv5_AP_t *ap, uint32_t addr, uint32_t mask,
+					  uint32_t value, uint32_t timeout_ms, uint32_t *result)
+{
+	platform_timeout timeout;
+	platform_timeout_set(&timeout, timeout_ms);
+	uint8_t cmd[16];
+	stlink_writemem_cmd(cmd, ap, addr, 4, 4);
+	cmd[1] = STLINK_DEBUG_READMEM_32BIT;
+	uint8_t status_cmd[16] = {
+		STLINK_DEBUG_COMMAND,
+		STLINK_DEBUG_APIV2_GETLASTRWSTATUS2
+	};
+	uint32_t val = 0;
+	bool done = false;
+	do {
+		uint8_t data[4];
+		uint8_t status[12];
+		pipe_send(cmd, 16);
+		pipe_recv(data, 4);
+		pipe_send(status_cmd, 16);
+		pipe_recv(status, 12);
+		if (pipe_flush())
+			break;
+		int res = stlink_usb_error_check(status, false);
+		if (res == STLINK_ERROR_WAIT)
+			continue;
+		if (res != STLINK_ERROR_OK)
+			break;
+		val = data[0] | data[1] << 8 | data[2] << 16 | data[3] << 24;
+		done = (val & mask) == value;
+	} while (!done && !platform_timeout_is_expired(&timeout));
+	DEBUG_STLINK("Poll AP %d addr 0x%08" PRIx32 ": 0x%08" PRIx32 " %s\n",
+				 ap->apsel, addr, val, done ? "done" : "failed");
+	*result = val;
+	return done;
 }
 
 void adiv5_ap_write(ADIv5_AP_t *ap, uint16_t addr, uint32_t value)
@@ -47,6 +47,12 @@ int stlink_usb_get_rw_status(void);
 void stlink_regs_read(ADIv5_AP_t *ap, void *data);
 uint32_t stlink_reg_read(ADIv5_AP_t *ap, int idx);
 void stlink_reg_write(ADIv5_AP_t *ap, int num, uint32_t val);
+void stlink_regs_read_list(ADIv5_AP_t *ap, const uint32_t *regnum, int n,
+						   uint32_t *data);
+void stlink_regs_write_list(ADIv5_AP_t *ap, const uint32_t *regnum, int n,
+							const uint32_t *data);
+int stlink_trace_start(uint32_t baudrate);
+void stlink_trace_stop(void);
 extern  int debug_level;
 # define DEBUG_STLINK if (debug_level > 0) printf
 # define DEBUG_USB    if (debug_level > 1) printf
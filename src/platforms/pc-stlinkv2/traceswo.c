@@ -0,0 +1,198 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.	 If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file implements the host side of SWO trace capture for the
+ * ST-Link. The adapter delivers the raw SWO byte stream, which is decoded
+ * here into ITM packets. The payload of each software stimulus port is
+ * written to its own file <basename>chanXX, like scripts/swolisten.c
+ * does. If that file is a FIFO (created with mkfifo), data is only
+ * written while a reader has it open and dropped otherwise.
+ */
+#include "general.h"
+#include "traceswo.h"
+#include "adiv5.h"
+#include "stlinkv2.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if !defined(O_NONBLOCK)
+#	define O_NONBLOCK 0
+#endif
+#if !defined(O_BINARY)
+#	define O_BINARY 0
+#endif
+
+#define ITM_CHANNELS	32
+#define ITM_CHAN_BUF	256
+
+enum itm_state {
+	ITM_IDLE,
+	ITM_SWIT,	/* Collecting software source payload */
+	ITM_SKIP,	/* Skipping hardware source payload */
+	ITM_CONT,	/* Skipping bytes with continuation bit set */
+};
+
+static struct {
+	bool running;
+	char basename[PATH_MAX - 8];
+	enum itm_state state;
+	int zeros;
+	int channel;
+	int count;
+	int size;
+	struct {
+		int fd;
+		bool fifo;
+		int len;
+		uint8_t buf[ITM_CHAN_BUF];
+	} chan[ITM_CHANNELS];
+} itm;
+
+static void itm_chan_open(int ch)
+{
+	char name[PATH_MAX];
+	snprintf(name, sizeof(name), "%schan%02X", itm.basename, ch);
+#if defined(S_ISFIFO)
+	struct stat st;
+	if (!stat(name, &st) && S_ISFIFO(st.st_mode)) {
+		/* Fails with ENXIO while nobody reads the FIFO */
+		itm.chan[ch].fd = open(name, O_WRONLY | O_NONBLOCK);
+		itm.chan[ch].fifo = true;
+		return;
+	}
+#endif
+	itm.chan[ch].fd = open(name, O_WRONLY | O_CREAT | O_APPEND | O_BINARY,
+	                       0644);
+	if (itm.chan[ch].fd < 0)
+		DEBUG("Can not open %s\n", name);
+}
+
+static void itm_chan_flush(int ch)
+{
+	if (!itm.chan[ch].len)
+		return;
+	if (itm.chan[ch].fd < 0)
+		itm_chan_open(ch);
+	if (itm.chan[ch].fd >= 0) {
+		int res = write(itm.chan[ch].fd, itm.chan[ch].buf, itm.chan[ch].len);
+		if ((res < 0) && itm.chan[ch].fifo) {
+			/* Reader went away, try to reopen next time */
+			close(itm.chan[ch].fd);
+			itm.chan[ch].fd = -1;
+		}
+	}
+	itm.chan[ch].len = 0;
+}
+
+static void itm_chan_write(int ch, uint8_t c)
+{
+	if (itm.chan[ch].len == ITM_CHAN_BUF)
+		itm_chan_flush(ch);
+	itm.chan[ch].buf[itm.chan[ch].len++] = c;
+}
+
+static void itm_header(uint8_t c)
+{
+	if (c == 0) {
+		/* Part of a synchronisation packet */
+		itm.zeros++;
+		return;
+	}
+	if ((c == 0x80) && (itm.zeros >= 5)) {
+		/* End of synchronisation packet */
+		itm.zeros = 0;
+		return;
+	}
+	itm.zeros = 0;
+	if (c == 0x70) {
+		DEBUG("ITM overflow\n");
+	} else if (c & 0x03) {
+		/* Source packet, payload of 1, 2 or 4 bytes */
+		itm.size = ((c & 0x03) == 3) ? 4 : (c & 0x03);
+		itm.count = 0;
+		itm.channel = c >> 3;
+		itm.state = (c & 0x04) ? ITM_SKIP : ITM_SWIT;
+	} else if (c & 0x80) {
+		/* Timestamp or extension packet with payload */
+		itm.state = ITM_CONT;
+	}
+}
+
+void traceswo_decode(const uint8_t *data, int len)
+{
+	if (!itm.running)
+		return;
+	for (int i = 0; i < len; i++) {
+		uint8_t c = data[i];
+		switch (itm.state) {
+		case ITM_IDLE:
+			itm_header(c);
+			break;
+		case ITM_SWIT:
+			itm_chan_write(itm.channel, c);
+			/* fall through */
+		case ITM_SKIP:
+			if (++itm.count == itm.size)
+				itm.state = ITM_IDLE;
+			break;
+		case ITM_CONT:
+			if (!(c & 0x80))
+				itm.state = ITM_IDLE;
+			break;
+		}
+	}
+	for (int ch = 0; ch < ITM_CHANNELS; ch++)
+		itm_chan_flush(ch);
+}
+
+bool traceswo_init(uint32_t baudrate, const char *basename)
+{
+	traceswo_stop();
+	strncpy(itm.basename, basename, sizeof(itm.basename) - 1);
+	itm.basename[sizeof(itm.basename) - 1] = 0;
+	itm.state = ITM_IDLE;
+	itm.zeros = 0;
+	for (int ch = 0; ch < ITM_CHANNELS; ch++) {
+		itm.chan[ch].fd = -1;
+		itm.chan[ch].fifo = false;
+		itm.chan[ch].len = 0;
+	}
+	itm.running = true;
+	if (stlink_trace_start(baudrate)) {
+		itm.running = false;
+		return false;
+	}
+	return true;
+}
+
+void traceswo_stop(void)
+{
+	if (!itm.running)
+		return;
+	stlink_trace_stop();
+	itm.running = false;
+	for (int ch = 0; ch < ITM_CHANNELS; ch++) {
+		if (itm.chan[ch].fd >= 0)
+			close(itm.chan[ch].fd);
+		itm.chan[ch].fd = -1;
+	}
+}
@@ -32,6 +32,8 @@
 #include "target.h"
 #include "target_internal.h"
 
+#include "crc32.h"
+#include "gdb_main.h"
 #include "cl_utils.h"
 
 #ifndef O_BINARY
@@ -119,6 +121,7 @@ static void cl_help(char **argv, BMP_CL_OPTIONS_t *opt)
 		  "serial number \"string\"\n");
 	printf("\t-c \"string\"\t: Use ftdi dongle with type \"string\"\n");
 	printf("\t-n\t\t:  Exit immediate if no device found\n");
+	printf("\t-P <num>\t: Use a GDB packet buffer of <num> bytes\n");
 	printf("\tRun mode related options:\n");
 	printf("\t-t\t\t: Scan SWD, with no target found scan jtag and exit\n");
 	printf("\t-E\t\t: Erase flash until flash end or for given size\n");
@@ -130,6 +133,7 @@ static void cl_help(char **argv, BMP_CL_OPTIONS_t *opt)
 	printf("\t-a <num>\t: Start flash operation at flash address <num>\n"
 		"\t\t\tDefault start is 0x08000000\n");
 	printf("\t-S <num>\t: Read <num> bytes. Default is until read fails.\n");
+	printf("\t-i\t\t: Only erase and write flash blocks that changed\n");
 	printf("\t-j\t\t: Use JTAG. SWD is default.\n");
 	printf("\t <file>\t\t: Use (binary) file <file> for flash operation\n"
 		   "\t\t\tGiven <file> writes to flash if neither -r or -V is given\n");
@@ -142,7 +146,7 @@ void cl_init(BMP_CL_OPTIONS_t *opt, int argc, char **argv)
 	opt->opt_target_dev = 1;
 	opt->opt_flash_start = 0x08000000;
 	opt->opt_flash_size = 16 * 1024 *1024;
-	while((c = getopt(argc, argv, "Ehv::s:c:nN:tVta:S:jrR")) != -1) {
+	while((c = getopt(argc, argv, "Ehiv::s:c:nN:P:tVta:S:jrR")) != -1) {
 		switch(c) {
 		case 'c':
 			if (optarg)
@@ -158,6 +162,9 @@ void cl_init(BMP_CL_OPTIONS_t *opt, int argc, char **argv)
 		case 'j':
 			opt->opt_usejtag = true;
 			break;
+		case 'i':
+			opt->opt_flash_incremental = true;
+			break;
 		case 'n':
 			opt->opt_no_wait = true;
 			break;
@@ -188,6 +195,11 @@ void cl_init(BMP_CL_OPTIONS_t *opt, int argc, char **argv)
 			if (optarg)
 				opt->opt_target_dev = strtol(optarg, NULL, 0);
 			break;
+		case 'P':
+			/* Register packets need at least 1 KiB */
+			if (optarg)
+				gdb_packet_size = MAX(strtoul(optarg, NULL, 0), 1024UL);
+			break;
 		case 'S':
 			if (optarg) {
 				char *endptr;
@@ -288,6 +300,7 @@ int cl_execute(BMP_CL_OPTIONS_t *opt)
 		}
 		target_reset(t);
 	} else if (opt->opt_mode == BMP_MODE_FLASH_WRITE) {
+		target_flash_incremental = opt->opt_flash_incremental;
 		DEBUG("Erase    %zu bytes at 0x%08" PRIx32 "\n", map.size,
 			  opt->opt_flash_start);
 		unsigned int erased = target_flash_erase(t, opt->opt_flash_start,
@@ -301,6 +314,8 @@ int cl_execute(BMP_CL_OPTIONS_t *opt)
 			unsigned int flashed = target_flash_write(t, opt->opt_flash_start,
 													  map.data, map.size);
 			/* Buffered write cares for padding*/
+			/* In incremental mode the last blocks are only written now */
+			flashed |= target_flash_done(t);
 			if (flashed) {
 				DEBUG("Flashing failed!\n");
 			} else {
@@ -308,10 +323,9 @@ int cl_execute(BMP_CL_OPTIONS_t *opt)
 				res = 0;
 			}
 		}
-		target_flash_done(t);
 		target_reset(t);
 	} else {
-#define WORKSIZE 1024
+#define WORKSIZE 0x1000
 		uint8_t *data = malloc(WORKSIZE);
 		if (!data) {
 			printf("Can not malloc memory for flash read/verify operation\n");
@@ -324,6 +338,14 @@ int cl_execute(BMP_CL_OPTIONS_t *opt)
 		uint32_t flash_src = opt->opt_flash_start;
 		size_t size = (opt->opt_mode == BMP_MODE_FLASH_READ) ? opt->opt_flash_size:
 			map.size;
+		/* Compare checksums first, only read back to locate a mismatch */
+		if ((opt->opt_mode == BMP_MODE_FLASH_VERIFY) &&
+			(generic_crc32(t, flash_src, size) == crc32_buffer(map.data, size))) {
+			printf("Verify succeeded for %zu bytes\n", size);
+			free(data);
+			res = 0;
+			goto free_map;
+		}
 		int bytes_read = 0;
 		void *flash = map.data;
 		while (size) {
@@ -38,6 +38,7 @@ typedef struct BMP_CL_OPTIONS_s {
 	enum bmp_cl_mode opt_mode;
 	bool opt_usejtag;
 	bool opt_no_wait;
+	bool opt_flash_incremental;
 	char *opt_flash_file;
 	char *opt_serial;
 	char *opt_cable;
@@ -21,6 +21,10 @@
 /* This file implements a transparent channel over which the GDB Remote
  * Serial Debugging protocol is implemented.  This implementation for Linux
  * uses a TCP server on port 2000.
+ *
+ * Up to NUM_GDB_CLIENTS connections are served at once. Each has its own
+ * receive buffer. gdb_if_wait() selects the connection that the other
+ * functions work on, see gdb_main.c for how sessions are scheduled.
  */
 
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -44,11 +48,32 @@
 #include "general.h"
 #include "gdb_if.h"
 
-static int gdb_if_serv, gdb_if_conn;
 #define DEFAULT_PORT 2000
 #define NUM_GDB_SERVER 4
+#define NUM_GDB_CLIENTS GDB_IF_MAX_CLIENTS
+
+/* A client that went away must not kill the server with SIGPIPE */
+#ifndef MSG_NOSIGNAL
+#   define MSG_NOSIGNAL 0
+#endif
+
+struct gdb_if_client {
+	int conn;
+	/* Received data not yet handed out by gdb_if_getchar() */
+	uint8_t rxbuf[2048];
+	int rxpos, rxlen;
+	/* Connected since gdb_if_accepted() last asked */
+	bool fresh;
+};
+
+static int gdb_if_serv;
+static struct gdb_if_client gdb_if_clients[NUM_GDB_CLIENTS];
+static struct gdb_if_client *gdb_if_cur = &gdb_if_clients[0];
+
 int gdb_if_init(void)
 {
+	for (int i = 0; i < NUM_GDB_CLIENTS; i++)
+		gdb_if_clients[i].conn = -1;
 #if defined(_WIN32) || defined(__CYGWIN__)
 	WSADATA wsaData;
 	WSAStartup(MAKEWORD(2, 2), &wsaData);
@@ -82,7 +107,7 @@ int gdb_if_init(void)
 			close(gdb_if_serv);
 			continue;
 		}
-		if (listen(gdb_if_serv, 1) == -1) {
+		if (listen(gdb_if_serv, NUM_GDB_CLIENTS) == -1) {
 			close(gdb_if_serv);
 			continue;
 		}
@@ -94,82 +119,143 @@ int gdb_if_init(void)
 }
 
 
-unsigned char gdb_if_getchar(void)
+static void gdb_if_accept(void)
 {
-	unsigned char ret;
-	int i = 0;
-#if defined(_WIN32) || defined(__CYGWIN__)
-	unsigned long opt;
-#else
-	int flags;
-#endif
-	while(i <= 0) {
-		if(gdb_if_conn <= 0) {
-#if defined(_WIN32) || defined(__CYGWIN__)
-			opt = 1;
-			ioctlsocket(gdb_if_serv, FIONBIO, &opt);
-#else
-			flags = fcntl(gdb_if_serv, F_GETFL);
-			fcntl(gdb_if_serv, F_SETFL, flags | O_NONBLOCK);
+	int i;
+	for (i = 0; i < NUM_GDB_CLIENTS; i++)
+		if (gdb_if_clients[i].conn == -1)
+			break;
+	int conn = accept(gdb_if_serv, NULL, NULL);
+	if (conn == -1) {
+		DEBUG("error when accepting connection: %s", strerror(errno));
+		return;
+	}
+	if (i == NUM_GDB_CLIENTS) {
+		DEBUG("Refused connection, %d clients connected\n", NUM_GDB_CLIENTS);
+		close(conn);
+		return;
+	}
+#if defined(SO_NOSIGPIPE)
+	int opt = 1;
+	setsockopt(conn, SOL_SOCKET, SO_NOSIGPIPE, (void*)&opt, sizeof(opt));
 #endif
-			while(1) {
-				gdb_if_conn = accept(gdb_if_serv, NULL, NULL);
-				if (gdb_if_conn == -1) {
-					if (errno == EWOULDBLOCK) {
-						SET_IDLE_STATE(1);
-						platform_delay(100);
-					} else {
-						DEBUG("error when accepting connection: %s", strerror(errno));
-						exit(1);
-					}
-				} else {
-#if defined(_WIN32) || defined(__CYGWIN__)
-					opt = 0;
-					ioctlsocket(gdb_if_serv, FIONBIO, &opt);
+	DEBUG("Got connection %d\n", i);
+	gdb_if_clients[i].conn = conn;
+	gdb_if_clients[i].rxpos = gdb_if_clients[i].rxlen = 0;
+	gdb_if_clients[i].fresh = true;
+}
+
+int gdb_if_wait(int timeout)
+{
+	struct gdb_if_client *c;
+	int start = gdb_if_cur - gdb_if_clients;
+	fd_set fds;
+# if defined(__CYGWIN__)
+	TIMEVAL tv;
 #else
-					fcntl(gdb_if_serv, F_SETFL, flags);
+	struct timeval tv;
 #endif
-					break;
-				}
+
+	while (1) {
+		/* Take turns, starting after the current client */
+		for (int i = 1; i <= NUM_GDB_CLIENTS; i++) {
+			c = &gdb_if_clients[(start + i) % NUM_GDB_CLIENTS];
+			if ((c->conn != -1) && (c->rxpos < c->rxlen)) {
+				gdb_if_cur = c;
+				return c - gdb_if_clients;
 			}
-			DEBUG("Got connection\n");
-#if defined(_WIN32) || defined(__CYGWIN__)
-			opt = 0;
-			ioctlsocket(gdb_if_conn, FIONBIO, &opt);
-#else
-			flags = fcntl(gdb_if_conn, F_GETFL);
-			fcntl(gdb_if_conn, F_SETFL, flags & ~O_NONBLOCK);
-#endif
 		}
-		i = recv(gdb_if_conn, (void*)&ret, 1, 0);
-		if(i <= 0) {
-			gdb_if_conn = -1;
-			DEBUG("Dropped broken connection: %s\n", strerror(errno));
-			/* Return '+' in case we were waiting for an ACK */
-			return '+';
+
+		int maxfd = gdb_if_serv;
+		FD_ZERO(&fds);
+		FD_SET(gdb_if_serv, &fds);
+		for (int i = 0; i < NUM_GDB_CLIENTS; i++) {
+			c = &gdb_if_clients[i];
+			if (c->conn == -1)
+				continue;
+			FD_SET(c->conn, &fds);
+			maxfd = MAX(maxfd, c->conn);
 		}
+		tv.tv_sec = timeout / 1000;
+		tv.tv_usec = (timeout % 1000) * 1000;
+		if (select(maxfd + 1, &fds, NULL, NULL,
+		           (timeout < 0) ? NULL : &tv) <= 0)
+			return -1;
+
+		if (FD_ISSET(gdb_if_serv, &fds))
+			gdb_if_accept();
+		for (int i = 1; i <= NUM_GDB_CLIENTS; i++) {
+			int n = (start + i) % NUM_GDB_CLIENTS;
+			c = &gdb_if_clients[n];
+			if ((c->conn != -1) && FD_ISSET(c->conn, &fds)) {
+				gdb_if_cur = c;
+				return n;
+			}
+		}
+		/* Only a new connection, nothing to read yet */
+	}
+}
+
+void gdb_if_select(int n)
+{
+	gdb_if_cur = &gdb_if_clients[n];
+}
+
+bool gdb_if_accepted(int n)
+{
+	bool fresh = gdb_if_clients[n].fresh;
+	gdb_if_clients[n].fresh = false;
+	return fresh;
+}
+
+unsigned char gdb_if_getchar(void)
+{
+	struct gdb_if_client *c = gdb_if_cur;
+
+	if (c->rxpos < c->rxlen)
+		return c->rxbuf[c->rxpos++];
+
+	/* Connections are only picked by gdb_if_wait() */
+	if (c->conn == -1)
+		return 0x04;
+
+	/* Take whatever is available, up to a full buffer */
+	int i = recv(c->conn, (void*)c->rxbuf, sizeof(c->rxbuf), 0);
+	if (i <= 0) {
+		DEBUG("Dropped broken connection: %s\n", strerror(errno));
+		close(c->conn);
+		c->conn = -1;
+		c->rxpos = c->rxlen = 0;
+		/* Detach, like the probe does when the port closes */
+		return 0x04;
 	}
-	return ret;
+	c->rxlen = i;
+	c->rxpos = 1;
+	return c->rxbuf[0];
 }
 
 unsigned char gdb_if_getchar_to(int timeout)
 {
+	struct gdb_if_client *c = gdb_if_cur;
 	fd_set fds;
 # if defined(__CYGWIN__)
-        TIMEVAL tv;
+	TIMEVAL tv;
 #else
 	struct timeval tv;
 #endif
 
-	if(gdb_if_conn == -1) return -1;
+	if(c->conn == -1) return -1;
+
+	if (c->rxpos < c->rxlen)
+		return c->rxbuf[c->rxpos++];
 
 	tv.tv_sec = timeout / 1000;
 	tv.tv_usec = (timeout % 1000) * 1000;
 
 	FD_ZERO(&fds);
-	FD_SET(gdb_if_conn, &fds);
+	FD_SET(c->conn, &fds);
 
-	if(select(gdb_if_conn+1, &fds, NULL, NULL, &tv) > 0)
+	if(select(c->conn+1, &fds, NULL, NULL, &tv) > 0)
 		return gdb_if_getchar();
 
 	return -1;
@@ -183,10 +269,10 @@ void gdb_if_putchar(unsigned char c, int flush)
 	static uint8_t buf[2048];
 #endif
 	static int bufsize = 0;
-	if (gdb_if_conn > 0) {
+	if (gdb_if_cur->conn != -1) {
 		buf[bufsize++] = c;
 		if (flush || (bufsize == sizeof(buf))) {
-			send(gdb_if_conn, buf, bufsize, 0);
+			send(gdb_if_cur->conn, buf, bufsize, MSG_NOSIGNAL);
 			bufsize = 0;
 		}
 	}
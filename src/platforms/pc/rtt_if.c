@@ -0,0 +1,174 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file implements the RTT channels of the hosted builds. Channel n
+ * is served on TCP port RTT_PORT + n, to one client at a time. Up buffer
+ * data stays in the target while no client is connected.
+ */
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+#   include <winsock2.h>
+#   include <windows.h>
+#   include <ws2tcpip.h>
+#else
+#   include <sys/socket.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
+#   include <sys/select.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "general.h"
+#include "rtt.h"
+
+#define RTT_PORT 19021
+
+/* A client that went away must not kill the server with SIGPIPE */
+#ifndef MSG_NOSIGNAL
+#   define MSG_NOSIGNAL 0
+#endif
+
+struct rtt_if_chan {
+	int serv;
+	int conn;
+};
+
+static struct rtt_if_chan rtt_if_chans[RTT_MAX_CHANNELS];
+static bool rtt_if_ready;
+
+static int rtt_if_listen(int port)
+{
+	struct sockaddr_in addr;
+	int opt = 1;
+	int s = socket(PF_INET, SOCK_STREAM, 0);
+
+	if (s == -1)
+		return -1;
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if ((setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (void*)&opt, sizeof(opt)) == -1) ||
+	    (setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (void*)&opt, sizeof(opt)) == -1) ||
+	    (bind(s, (void*)&addr, sizeof(addr)) == -1) ||
+	    (listen(s, 1) == -1)) {
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+int rtt_if_init(void)
+{
+	if (rtt_if_ready)
+		return 0;
+	for (int i = 0; i < RTT_MAX_CHANNELS; i++) {
+		struct rtt_if_chan *c = &rtt_if_chans[i];
+		c->conn = -1;
+		c->serv = rtt_if_listen(RTT_PORT + i);
+		if (c->serv == -1)
+			DEBUG("RTT channel %d: can't listen on TCP %d: %s\n",
+			      i, RTT_PORT + i, strerror(errno));
+		else
+			DEBUG("RTT channel %d on TCP: %d\n", i, RTT_PORT + i);
+	}
+	rtt_if_ready = true;
+	return 0;
+}
+
+/* Check without waiting whether s can be read or written */
+static bool rtt_if_poll(int s, bool write)
+{
+	fd_set fds;
+# if defined(__CYGWIN__)
+	TIMEVAL tv = {0, 0};
+#else
+	struct timeval tv = {0, 0};
+#endif
+
+	FD_ZERO(&fds);
+	FD_SET(s, &fds);
+	return select(s + 1, write ? NULL : &fds, write ? &fds : NULL,
+	              NULL, &tv) > 0;
+}
+
+/* Returns the client of channel chan, accepting a waiting one if needed */
+static struct rtt_if_chan *rtt_if_client(unsigned chan)
+{
+	if (!rtt_if_ready || (chan >= RTT_MAX_CHANNELS))
+		return NULL;
+
+	struct rtt_if_chan *c = &rtt_if_chans[chan];
+	if ((c->conn == -1) && (c->serv != -1) && rtt_if_poll(c->serv, false)) {
+		c->conn = accept(c->serv, NULL, NULL);
+		if (c->conn != -1) {
+#if defined(SO_NOSIGPIPE)
+			int opt = 1;
+			setsockopt(c->conn, SOL_SOCKET, SO_NOSIGPIPE,
+			           (void*)&opt, sizeof(opt));
+#endif
+			DEBUG("RTT channel %u: got connection\n", chan);
+		}
+	}
+	return (c->conn == -1) ? NULL : c;
+}
+
+static void rtt_if_drop(struct rtt_if_chan *c)
+{
+	DEBUG("RTT channel %d: dropped connection\n", (int)(c - rtt_if_chans));
+	close(c->conn);
+	c->conn = -1;
+}
+
+int rtt_if_write(unsigned chan, const void *buf, size_t len)
+{
+	struct rtt_if_chan *c = rtt_if_client(chan);
+
+	if (!c || !rtt_if_poll(c->conn, true))
+		return 0;
+	int n = send(c->conn, buf, len, MSG_NOSIGNAL);
+	if (n <= 0) {	/* EPIPE or reset: the client closed its end */
+		rtt_if_drop(c);
+		return 0;
+	}
+	return n;
+}
+
+/* Unread data waits in the socket without holding anything else up */
+void rtt_if_discard(unsigned chan)
+{
+	(void)chan;
+}
+
+int rtt_if_read(unsigned chan, void *buf, size_t len)
+{
+	struct rtt_if_chan *c = rtt_if_client(chan);
+
+	if (!c || !rtt_if_poll(c->conn, false))
+		return 0;
+	int n = recv(c->conn, buf, len, 0);
+	if (n <= 0) {
+		rtt_if_drop(c);
+		return 0;
+	}
+	return n;
+}
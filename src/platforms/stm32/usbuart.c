@@ -29,6 +29,9 @@
 
 #include "general.h"
 #include "cdcacm.h"
+#if defined(PLATFORM_HAS_RTT)
+#	include "rtt.h"
+#endif
 
 #define USBUART_TIMER_FREQ_HZ 1000000U /* 1us per tick */
 #define USBUART_RUN_FREQ_HZ 5000U /* 200us (or 100 characters at 2Mbps) */
@@ -42,6 +45,14 @@ static uint8_t buf_rx_in;
 /* Fifo out pointer, writes assumed to be atomic, should be only incremented outside RX ISR */
 static uint8_t buf_rx_out;
 
+#if defined(PLATFORM_HAS_RTT)
+/* Packet from the host waiting to go to the RTT down buffer. The endpoint
+ * is NAKed until it is taken by rtt_if_read(). */
+static uint8_t rtt_down[CDCACM_PACKET_SIZE];
+static volatile uint8_t rtt_down_len;
+static volatile uint8_t rtt_down_pos;
+#endif
+
 static void usbuart_run(void);
 
 void usbuart_init(void)
@@ -170,6 +181,18 @@ void usbuart_usb_out_cb(usbd_device *dev, uint8_t ep)
 	int len = usbd_ep_read_packet(dev, CDCACM_UART_ENDPOINT,
 					buf, CDCACM_PACKET_SIZE);
 
+#if defined(PLATFORM_HAS_RTT)
+	if (rtt_enabled() && rtt_control_block()) {
+		usbd_ep_nak_set(dev, CDCACM_UART_ENDPOINT, 1);
+		/* Empty while updated, rtt_if_read() may run meanwhile */
+		rtt_down_len = 0;
+		rtt_down_pos = 0;
+		memcpy(rtt_down, buf, len);
+		rtt_down_len = len;
+		return;
+	}
+#endif
+
 #if defined(BLACKMAGIC)
 	/* Don't bother if uart is disabled.
 	 * This will be the case on mini while we're being debugged.
@@ -201,6 +224,58 @@ int usbuart_debug_write(const char *buf, size_t len)
 }
 #endif
 
+#if defined(PLATFORM_HAS_RTT)
+/* RTT channel 0 shares the interface with the UART. Up buffer data is
+ * queued like received characters, while RTT is enabled data from the
+ * host goes to the down buffer instead of the UART. */
+int rtt_if_init(void)
+{
+	return 0;
+}
+
+int rtt_if_write(unsigned chan, const void *buf, size_t len)
+{
+	const uint8_t *data = buf;
+	size_t i;
+
+	if (chan || (cdcacm_get_config() != 1))
+		return 0;
+	/* The RX interrupt also moves buf_rx_in */
+	nvic_disable_irq(USBUSART_IRQ);
+	for (i = 0; i < len; i++) {
+		uint8_t next = (buf_rx_in + 1) % FIFO_SIZE;
+		if (next == buf_rx_out)
+			break;
+		buf_rx[buf_rx_in] = data[i];
+		buf_rx_in = next;
+	}
+	nvic_enable_irq(USBUSART_IRQ);
+	if (i)
+		timer_enable_irq(USBUSART_TIM, TIM_DIER_UIE);
+	return i;
+}
+
+int rtt_if_read(unsigned chan, void *buf, size_t len)
+{
+	if (chan || (rtt_down_pos == rtt_down_len))
+		return 0;
+	len = MIN(len, (size_t)(rtt_down_len - rtt_down_pos));
+	memcpy(buf, rtt_down + rtt_down_pos, len);
+	rtt_down_pos += len;
+	if (rtt_down_pos == rtt_down_len)
+		usbd_ep_nak_set(usbdev, CDCACM_UART_ENDPOINT, 0);
+	return len;
+}
+
+void rtt_if_discard(unsigned chan)
+{
+	if (chan || (rtt_down_pos == rtt_down_len))
+		return;
+	rtt_down_pos = rtt_down_len;
+	usbd_ep_nak_set(usbdev, CDCACM_UART_ENDPOINT, 0);
+}
+#endif
+
 void usbuart_usb_in_cb(usbd_device *dev, uint8_t ep)
 {
 	(void) dev;
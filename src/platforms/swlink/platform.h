@@ -63,6 +63,7 @@
 #define LED_UART	GPIO14
 
 #define PLATFORM_HAS_TRACESWO	1
+#define PLATFORM_HAS_RTT
 #define NUM_TRACE_PACKETS		(128)		/* This is an 8K buffer */
 #define TRACESWO_PROTOCOL		2			/* 1 = Manchester, 2 = NRZ / async */
 
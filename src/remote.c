@@ -25,6 +25,10 @@
 #include "jtagtap.h"
 #include "gdb_if.h"
 #include "version.h"
+#include "exception.h"
+#include "adiv5.h"
+#include "target.h"
+#include "target_internal.h"
 #include <stdarg.h>
 
 
@@ -254,6 +258,108 @@ void remotePacketProcessGEN(uint8_t i, char *packet)
     }
 }
 
+static void _respondMem32(const struct target_mem32 *ops, size_t n)
+/* Send the values of a read batch to far end */
+{
+	gdb_if_putchar(REMOTE_RESP,0);
+	gdb_if_putchar(REMOTE_RESP_OK,0);
+	for (size_t j = 0; j < n; j++)
+		for (int shift = 28; shift >= 0; shift -= 4) {
+			uint8_t x = (ops[j].value >> shift) & 0x0f;
+			gdb_if_putchar(NTOH(x), 0);
+		}
+	gdb_if_putchar(REMOTE_EOM,1);
+}
+
+static ADIv5_DP_t remote_dp;
+static ADIv5_AP_t remote_ap = { .dp = &remote_dp };
+
+static uint32_t _remoteMem32Batch(bool write, struct target_mem32 *ops,
+                                  size_t n)
+/* Run the batch, return the type of exception raised, if any */
+{
+	volatile struct exception e;
+	remote_dp.fault = 0;
+	TRY_CATCH (e, EXCEPTION_ALL) {
+		if (write)
+			adiv5_mem_write32_batch(&remote_ap, ops, n);
+		else
+			adiv5_mem_read32_batch(&remote_ap, ops, n);
+	}
+	return e.type;
+}
+
+static uint32_t _remoteMemPoll32(struct target_mem32 *op, uint32_t mask,
+                                 uint32_t timeout_ms)
+/* Spin until the masked value matches, return the type of exception
+ * raised, if any. The last value read is left in op. */
+{
+	volatile struct exception e;
+	remote_dp.fault = 0;
+	TRY_CATCH (e, EXCEPTION_ALL) {
+		adiv5_mem_poll32(&remote_ap, op->addr, mask, op->value,
+		                 MIN(timeout_ms, REMOTE_MAX_POLL_MS), &op->value);
+	}
+	return e.type;
+}
+
+void remotePacketProcessADIv5(uint8_t i, char *packet)
+{
+	struct target_mem32 ops[REMOTE_MAX_BATCH];
+	size_t n;
+	uint32_t exception;
+
+	if (!remote_dp.low_access)
+		adiv5_swdp_setup(&remote_dp);
+	remote_ap.apsel = remotehston(2, &packet[2]);
+	remote_ap.csw = remotehston(8, &packet[4]);
+
+	switch (packet[1]) {
+	case REMOTE_MEM_READ32: /* Am = read batch ======================= */
+	case REMOTE_MEM_WRITE32: /* AM = write batch ===================== */
+	{
+		bool write = (packet[1] == REMOTE_MEM_WRITE32);
+		int oplen = write ? 16 : 8;
+		n = remotehston(2, &packet[12]);
+		if ((i < 14) || (n > REMOTE_MAX_BATCH) || (i != 14 + n * oplen)) {
+			_respond(REMOTE_RESP_ERR,REMOTE_ERROR_WRONGLEN);
+			return;
+		}
+		for (size_t j = 0; j < n; j++) {
+			char *op = &packet[14 + j * oplen];
+			ops[j].addr = remotehston(8, op);
+			ops[j].value = write ? remotehston(8, op + 8) : 0;
+		}
+		exception = _remoteMem32Batch(write, ops, n);
+		if (write)
+			n = 0;
+		break;
+	}
+	case REMOTE_MEM_POLL32: /* Ap = poll ============================ */
+		if (i != 40) {
+			_respond(REMOTE_RESP_ERR,REMOTE_ERROR_WRONGLEN);
+			return;
+		}
+		ops[0].addr = remotehston(8, &packet[12]);
+		ops[0].value = remotehston(8, &packet[28]);
+		exception = _remoteMemPoll32(&ops[0], remotehston(8, &packet[20]),
+		                             remotehston(4, &packet[36]));
+		n = 1;
+		break;
+
+	default:
+		_respond(REMOTE_RESP_ERR,REMOTE_ERROR_UNRECOGNISED);
+		return;
+	}
+
+	if (exception)
+		_respond(REMOTE_RESP_ERR,REMOTE_ERROR_EXCEPTION);
+	else if (remote_dp.fault)
+		_respond(REMOTE_RESP_ERR,REMOTE_ERROR_FAULT);
+	else
+		_respondMem32(ops, n);
+}
+
 void remotePacketProcess(uint8_t i, char *packet)
 {
 	switch (packet[0]) {
@@ -269,6 +375,10 @@ void remotePacketProcess(uint8_t i, char *packet)
 		remotePacketProcessGEN(i,packet);
 		break;
 
+    case REMOTE_ADIv5_PACKET:
+		remotePacketProcessADIv5(i,packet);
+		break;
+
     default: /* Oh dear, unrecognised, return an error */
 		_respond(REMOTE_RESP_ERR,REMOTE_ERROR_UNRECOGNISED);
 		break;
@@ -53,6 +53,8 @@
 /* Protocol error messages */
 #define REMOTE_ERROR_UNRECOGNISED 1
 #define REMOTE_ERROR_WRONGLEN     2
+#define REMOTE_ERROR_FAULT        3
+#define REMOTE_ERROR_EXCEPTION    4
 
 /* Start and end of message identifiers */
 #define REMOTE_SOM         '!'
@@ -125,7 +127,54 @@
 #define REMOTE_JTAG_NEXT (char []){ REMOTE_SOM, REMOTE_JTAG_PACKET, REMOTE_NEXT, \
                                        '%','c','%','c',REMOTE_EOM, 0 }
 
+/* ADIv5 protocol elements
+ *
+ * Batches of 32-bit memory accesses through a MEM-AP, executed by the
+ * probe in one round trip. The header gives AP, CSW and the number of
+ * accesses, followed by one address (and value, for writes) each:
+ *
+ *  Am - read batch  !Am<ap:2><csw:8><n:2>{<addr:8>}#
+ *       resp: K{<value:8>}
+ *  AM - write batch !AM<ap:2><csw:8><n:2>{<addr:8><value:8>}#
+ *       resp: K
+ *  Ap - poll        !Ap<ap:2><csw:8><addr:8><mask:8><value:8><ms:4>#
+ *       resp: K<value:8> - last value read, the caller checks for a match
+ *
+ * The probe spins on a poll for at most REMOTE_MAX_POLL_MS, so the
+ * response arrives before the host's read timeout. Longer polls are
+ * issued as repeated requests.
+ *
+ * A sticky fault is reported as E03, a protocol exception as E04.
+ */
+#define REMOTE_ADIv5_PACKET 'A'
+#define REMOTE_MEM_READ32   'm'
+#define REMOTE_MEM_WRITE32  'M'
+#define REMOTE_MEM_POLL32   'p'
+#define REMOTE_MAX_BATCH    8
+#define REMOTE_MAX_POLL_MS  50
+
+#define REMOTE_MEM_READ32_STR (char []){ REMOTE_SOM, REMOTE_ADIv5_PACKET, REMOTE_MEM_READ32, \
+      '%','0','2','x','%','0','8','x','%','0','2','x', 0 }
+
+#define REMOTE_MEM_WRITE32_STR (char []){ REMOTE_SOM, REMOTE_ADIv5_PACKET, REMOTE_MEM_WRITE32, \
+      '%','0','2','x','%','0','8','x','%','0','2','x', 0 }
+
+#define REMOTE_MEM_POLL32_STR (char []){ REMOTE_SOM, REMOTE_ADIv5_PACKET, REMOTE_MEM_POLL32, \
+      '%','0','2','x','%','0','8','x','%','0','8','x','%','0','8','x','%','0','8','x', \
+      '%','0','4','x', REMOTE_EOM, 0 }
+
 uint64_t remotehston(uint32_t limit, char *s);
 void remotePacketProcess(uint8_t i, char *packet);
 
+#if defined(PLATFORM_HAS_REMOTE_BATCH)
+struct ADIv5_AP_s;
+struct target_mem32;
+void remote_mem_read32_batch(struct ADIv5_AP_s *ap, struct target_mem32 *ops,
+                             size_t n);
+void remote_mem_write32_batch(struct ADIv5_AP_s *ap,
+                              const struct target_mem32 *ops, size_t n);
+bool remote_mem_poll32(struct ADIv5_AP_s *ap, uint32_t addr, uint32_t mask,
+                       uint32_t value, uint32_t timeout_ms, uint32_t *result);
+#endif
+
 #endif
@@ -0,0 +1,264 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file implements the probe side of SEGGER's Real Time Transfer.
+ *
+ * The target keeps a control block in RAM, starting with the string
+ * "SEGGER RTT" and followed by descriptors of its up (target to host) and
+ * down (host to target) ring buffers. While the target runs, the
+ * descriptors are read through the debug port and new data is moved
+ * between the ring buffers and the platform's rtt_if channels. The target
+ * only writes WrOff of up buffers and RdOff of down buffers, the probe
+ * only the other offset, so no locking is needed.
+ */
+
+#include "general.h"
+#include "target.h"
+#include "target_internal.h"
+#include "rtt.h"
+
+#define RTT_ID		"SEGGER RTT"
+#define RTT_ID_SIZE	16
+/* Larger buffer counts are taken as a false match of RTT_ID */
+#define RTT_MAX_BUFFERS	16
+
+/* Bytes moved per channel and poll, also the step of the RAM search */
+#if defined(PC_HOSTED)
+# define RTT_CHUNK	1024
+#else
+# define RTT_CHUNK	256
+#endif
+
+/* The search is repeated at this interval until a control block shows up */
+#define RTT_SCAN_INTERVAL_MS	1000
+
+struct rtt_header {
+	char id[RTT_ID_SIZE];
+	uint32_t num_up;
+	uint32_t num_down;
+};
+
+/* Layout of a ring buffer descriptor in target memory */
+struct rtt_desc {
+	uint32_t name;
+	uint32_t buf;
+	uint32_t size;
+	uint32_t wroff;
+	uint32_t rdoff;
+	uint32_t flags;
+};
+
+#define RTT_DESC_WROFF	12
+#define RTT_DESC_RDOFF	16
+
+static struct {
+	bool enabled;
+	target *t;
+	/* Set by the user, otherwise the control block is searched for */
+	target_addr cb_fixed;
+	target_addr cb;
+	/* Limits searches while no control block is found */
+	bool searched;
+	platform_timeout scan;
+} rtt;
+
+static uint8_t rtt_buf[RTT_CHUNK + RTT_ID_SIZE];
+
+bool rtt_enable(target *t, target_addr cb)
+{
+	if (rtt_if_init())
+		return false;
+	rtt.enabled = true;
+	rtt.t = t;
+	rtt.cb_fixed = cb;
+	rtt.cb = 0;
+	rtt.searched = false;
+	return true;
+}
+
+/* Discard host data of the channels from chan on */
+static void rtt_discard(unsigned chan)
+{
+	for (; chan < RTT_MAX_CHANNELS; chan++)
+		rtt_if_discard(chan);
+}
+
+void rtt_disable(void)
+{
+	rtt.enabled = false;
+	rtt.cb = 0;
+	rtt_discard(0);
+}
+
+bool rtt_enabled(void)
+{
+	return rtt.enabled;
+}
+
+target_addr rtt_control_block(void)
+{
+	return rtt.cb;
+}
+
+void rtt_target_destroyed(target *t)
+{
+	if (rtt.t != t)
+		return;
+	rtt.t = NULL;
+	rtt.cb = 0;
+	rtt.searched = false;
+	rtt_discard(0);
+}
+
+void rtt_target_halted(target *t)
+{
+	if (rtt.enabled && (rtt.t == t))
+		rtt_discard(0);
+}
+
+static bool rtt_read_header(target *t, target_addr cb, struct rtt_header *hdr)
+{
+	if (target_mem_read(t, hdr, cb, sizeof(*hdr)))
+		return false;
+	return !memcmp(hdr->id, RTT_ID, sizeof(RTT_ID)) &&
+	       (hdr->num_up <= RTT_MAX_BUFFERS) &&
+	       (hdr->num_down <= RTT_MAX_BUFFERS);
+}
+
+/* Search the RAM regions of t for a control block. Blocks are word
+ * aligned, as they start with the ID followed by two words. */
+static target_addr rtt_find(target *t)
+{
+	struct rtt_header hdr;
+
+	for (struct target_ram *r = t->ram; r; r = r->next) {
+		target_addr end = r->start + r->length;
+		for (target_addr a = r->start; a < end; a += RTT_CHUNK) {
+			size_t len = MIN(sizeof(rtt_buf), end - a);
+			if (target_mem_read(t, rtt_buf, a, len))
+				break;
+			for (size_t i = 0; i + RTT_ID_SIZE <= len; i += 4) {
+				if (memcmp(rtt_buf + i, RTT_ID, sizeof(RTT_ID)))
+					continue;
+				if (rtt_read_header(t, a + i, &hdr))
+					return a + i;
+			}
+		}
+	}
+	return 0;
+}
+
+static bool rtt_poll_up(target *t, unsigned chan,
+                        const struct rtt_desc *d, target_addr desc)
+{
+	uint32_t rd = d->rdoff, wr = d->wroff;
+
+	if ((rd == wr) || (rd >= d->size) || (wr >= d->size))
+		return false;
+	/* Up to the write offset or the end of the buffer, whichever is first */
+	size_t len = MIN((wr > rd) ? wr - rd : d->size - rd, RTT_CHUNK);
+	if (target_mem_read(t, rtt_buf, d->buf + rd, len))
+		return false;
+	int n = rtt_if_write(chan, rtt_buf, len);
+	if (n <= 0)
+		return false;
+	target_mem_write32(t, desc + RTT_DESC_RDOFF, (rd + n) % d->size);
+	return true;
+}
+
+static bool rtt_poll_down(target *t, unsigned chan,
+                          const struct rtt_desc *d, target_addr desc)
+{
+	uint32_t rd = d->rdoff, wr = d->wroff;
+
+	if ((rd >= d->size) || (wr >= d->size))
+		return false;
+	/* One byte stays free, a full buffer would look empty */
+	size_t space = (rd > wr) ? rd - wr - 1 : d->size - wr - (rd == 0);
+	space = MIN(space, RTT_CHUNK);
+	if (!space)
+		return false;
+	int n = rtt_if_read(chan, rtt_buf, space);
+	if (n <= 0)
+		return false;
+	target_mem_write(t, d->buf + wr, rtt_buf, n);
+	target_mem_write32(t, desc + RTT_DESC_WROFF, (wr + n) % d->size);
+	return true;
+}
+
+bool rtt_poll(target *t)
+{
+	struct {
+		struct rtt_header hdr;
+		struct rtt_desc up[RTT_MAX_CHANNELS];
+	} cb;
+	struct rtt_desc down[RTT_MAX_CHANNELS];
+	bool busy = false;
+
+	if (!rtt.enabled)
+		return false;
+	if (!rtt.t)
+		rtt.t = t;
+	if (t != rtt.t)
+		return false;
+
+	if (!rtt.cb) {
+		if (rtt.searched && !platform_timeout_is_expired(&rtt.scan))
+			return false;
+		rtt.searched = true;
+		platform_timeout_set(&rtt.scan, RTT_SCAN_INTERVAL_MS);
+		if (!rtt.cb_fixed)
+			rtt.cb = rtt_find(t);
+		else if (rtt_read_header(t, rtt.cb_fixed, &cb.hdr))
+			rtt.cb = rtt.cb_fixed;
+		if (!rtt.cb) {
+			rtt_discard(0);
+			return false;
+		}
+		DEBUG("RTT control block at 0x%08" PRIx32 "\n", rtt.cb);
+	}
+
+	/* The ID is checked every time, the target may have been reset
+	 * or reloaded meanwhile */
+	if (target_mem_read(t, &cb, rtt.cb, sizeof(cb)) ||
+	    memcmp(cb.hdr.id, RTT_ID, sizeof(RTT_ID)) ||
+	    (cb.hdr.num_up > RTT_MAX_BUFFERS) ||
+	    (cb.hdr.num_down > RTT_MAX_BUFFERS)) {
+		DEBUG("RTT control block lost\n");
+		rtt.cb = 0;
+		rtt_discard(0);
+		return false;
+	}
+
+	target_addr desc = rtt.cb + sizeof(cb.hdr);
+	unsigned n = MIN(cb.hdr.num_up, RTT_MAX_CHANNELS);
+	for (unsigned i = 0; i < n; i++)
+		busy |= rtt_poll_up(t, i, &cb.up[i],
+		                    desc + i * sizeof(struct rtt_desc));
+
+	desc += cb.hdr.num_up * sizeof(struct rtt_desc);
+	n = MIN(cb.hdr.num_down, RTT_MAX_CHANNELS);
+	if (n && !target_mem_read(t, down, desc, n * sizeof(struct rtt_desc)))
+		for (unsigned i = 0; i < n; i++)
+			busy |= rtt_poll_down(t, i, &down[i],
+			                      desc + i * sizeof(struct rtt_desc));
+	/* Channels without a down buffer */
+	rtt_discard(n);
+	return busy;
+}
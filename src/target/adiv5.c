@@ -655,6 +655,97 @@ void adiv5_mem_write_sized(ADIv5_AP_t *ap, uint32_t dest, const void *src,
 	}
 }
 
+/* Batched word access: CSW is programmed once and TAR only where the
+ * next address does not follow by auto-increment. Faults stick in the DP
+ * and are picked up by the caller's error check at the end. */
+void adiv5_mem_read32_batch(ADIv5_AP_t *ap, struct target_mem32 *ops,
+                            size_t n)
+{
+	if (n == 0)
+		return;
+	if (ap->dp->mem_read32_batch) {
+		ap->dp->mem_read32_batch(ap, ops, n);
+		return;
+	}
+	adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_ADDRINC_SINGLE |
+	               ADIV5_AP_CSW_SIZE_WORD);
+	uint32_t tar = 0;
+	bool tar_valid = false;
+	bool pending = false;
+	for (size_t i = 0; i < n; i++) {
+		if (!tar_valid || (ops[i].addr != tar)) {
+			/* Collect the posted read before touching TAR */
+			if (pending)
+				ops[i - 1].value = adiv5_dp_low_access(ap->dp,
+						ADIV5_LOW_READ, ADIV5_DP_RDBUFF, 0);
+			pending = false;
+			adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR,
+			                    ops[i].addr);
+		}
+		uint32_t val = adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ,
+		                                   ADIV5_AP_DRW, 0);
+		if (pending)
+			ops[i - 1].value = val;
+		pending = true;
+		tar = ops[i].addr + 4;
+		/* Auto-increment is only guaranteed within 1 kiB */
+		tar_valid = (tar & 0x3ff) != 0;
+	}
+	ops[n - 1].value = adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ,
+	                                       ADIV5_DP_RDBUFF, 0);
+}
+
+void adiv5_mem_write32_batch(ADIv5_AP_t *ap, const struct target_mem32 *ops,
+                             size_t n)
+{
+	if (n == 0)
+		return;
+	if (ap->dp->mem_write32_batch) {
+		ap->dp->mem_write32_batch(ap, ops, n);
+		return;
+	}
+	adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_ADDRINC_SINGLE |
+	               ADIV5_AP_CSW_SIZE_WORD);
+	uint32_t tar = 0;
+	bool tar_valid = false;
+	for (size_t i = 0; i < n; i++) {
+		if (!tar_valid || (ops[i].addr != tar))
+			adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR,
+			                    ops[i].addr);
+		adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DRW,
+		                    ops[i].value);
+		tar = ops[i].addr + 4;
+		tar_valid = (tar & 0x3ff) != 0;
+	}
+}
+
+/* Spin on a word without going back to the caller for each read.
+ * TAR is set up once with auto-increment disabled. */
+bool adiv5_mem_poll32(ADIv5_AP_t *ap, uint32_t addr, uint32_t mask,
+                      uint32_t value, uint32_t timeout_ms, uint32_t *result)
+{
+	if (ap->dp->mem_poll32)
+		return ap->dp->mem_poll32(ap, addr, mask, value, timeout_ms, result);
+	adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_SIZE_WORD);
+	adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR, addr);
+	platform_timeout timeout;
+	platform_timeout_set(&timeout, timeout_ms);
+	uint32_t val;
+	bool done;
+	do {
+		adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_AP_DRW, 0);
+		val = adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ,
+		                          ADIV5_DP_RDBUFF, 0);
+		done = (val & mask) == value;
+		/* Give up early on a bus error, cleared by the caller */
+		if (!done && (adiv5_dp_read(ap->dp, ADIV5_DP_CTRLSTAT) &
+		              ADIV5_DP_CTRLSTAT_STICKYERR))
+			break;
+	} while (!done && !platform_timeout_is_expired(&timeout));
+	*result = val;
+	return done;
+}
+
 void adiv5_ap_write(ADIv5_AP_t *ap, uint16_t addr, uint32_t value)
 {
 	adiv5_dp_write(ap->dp, ADIV5_DP_SELECT,
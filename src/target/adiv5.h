@@ -129,6 +129,9 @@ enum align {
 	ALIGN_DWORD    = 3
 };
 
+struct ADIv5_AP_s;
+struct target_mem32;
+
 /* Try to keep this somewhat absract for later adding SW-DP */
 typedef struct ADIv5_DP_s {
 	int refcnt;
@@ -143,6 +146,14 @@ typedef struct ADIv5_DP_s {
                                uint16_t addr, uint32_t value);
 	void (*abort)(struct ADIv5_DP_s *dp, uint32_t abort);
 
+	/* Optional, e.g. to have a remote probe execute a whole batch */
+	void (*mem_read32_batch)(struct ADIv5_AP_s *ap,
+	                         struct target_mem32 *ops, size_t n);
+	void (*mem_write32_batch)(struct ADIv5_AP_s *ap,
+	                          const struct target_mem32 *ops, size_t n);
+	bool (*mem_poll32)(struct ADIv5_AP_s *ap, uint32_t addr, uint32_t mask,
+	                   uint32_t value, uint32_t timeout_ms, uint32_t *result);
+
 	union {
 		jtag_dev_t *dev;
 		uint8_t fault;
@@ -195,10 +206,17 @@ void adiv5_ap_write(ADIv5_AP_t *ap, uint16_t addr, uint32_t value);
 uint32_t adiv5_ap_read(ADIv5_AP_t *ap, uint16_t addr);
 
 void adiv5_jtag_dp_handler(jtag_dev_t *dev);
+void adiv5_swdp_setup(ADIv5_DP_t *dp);
 
 void adiv5_mem_read(ADIv5_AP_t *ap, void *dest, uint32_t src, size_t len);
 void adiv5_mem_write(ADIv5_AP_t *ap, uint32_t dest, const void *src, size_t len);
 void adiv5_mem_write_sized(ADIv5_AP_t *ap, uint32_t dest, const void *src,
 						   size_t len, enum align align);
+void adiv5_mem_read32_batch(ADIv5_AP_t *ap, struct target_mem32 *ops,
+                            size_t n);
+void adiv5_mem_write32_batch(ADIv5_AP_t *ap, const struct target_mem32 *ops,
+                             size_t n);
+bool adiv5_mem_poll32(ADIv5_AP_t *ap, uint32_t addr, uint32_t mask,
+                      uint32_t value, uint32_t timeout_ms, uint32_t *result);
 
 #endif
@@ -28,6 +28,9 @@
 #include "swdptap.h"
 #include "target.h"
 #include "target_internal.h"
+#if defined(PLATFORM_HAS_REMOTE_BATCH)
+#include "remote.h"
+#endif
 
 #define SWDP_ACK_OK    0x01
 #define SWDP_ACK_WAIT  0x02
@@ -76,10 +79,13 @@ int adiv5_swdp_scan(void)
 		return -1;
 	}
 
-	dp->dp_read = adiv5_swdp_read;
-	dp->error = adiv5_swdp_error;
-	dp->low_access = adiv5_swdp_low_access;
-	dp->abort = adiv5_swdp_abort;
+	adiv5_swdp_setup(dp);
+#if defined(PLATFORM_HAS_REMOTE_BATCH)
+	/* Let the probe run memory access batches on its own */
+	dp->mem_read32_batch = remote_mem_read32_batch;
+	dp->mem_write32_batch = remote_mem_write32_batch;
+	dp->mem_poll32 = remote_mem_poll32;
+#endif
 
 	adiv5_swdp_error(dp);
 	adiv5_dp_init(dp);
@@ -87,6 +93,14 @@ int adiv5_swdp_scan(void)
 	return target_list?1:0;
 }
 
+void adiv5_swdp_setup(ADIv5_DP_t *dp)
+{
+	dp->dp_read = adiv5_swdp_read;
+	dp->error = adiv5_swdp_error;
+	dp->low_access = adiv5_swdp_low_access;
+	dp->abort = adiv5_swdp_abort;
+}
+
 static uint32_t adiv5_swdp_read(ADIv5_DP_t *dp, uint16_t addr)
 {
 	if (addr & ADIV5_APnDP) {
@@ -0,0 +1,395 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file implements an interpreter for GDB agent expressions, as
+ * described in the "Agent Expressions" appendix of "Debugging with GDB".
+ * Expressions are evaluated against a halted target, registers are read
+ * through the register cache.
+ *
+ * The trace bytecodes hand the memory they name to a collection function,
+ * they are only valid when one is given. Floating point and trace state
+ * variable bytecodes are not supported and end the evaluation with an
+ * error.
+ */
+
+#include "general.h"
+#include "target.h"
+#include "target_internal.h"
+
+#define AGENT_STACK_SIZE	32
+/* Bound on the bytecodes run, expressions may contain loops */
+#define AGENT_MAX_STEPS		10000
+
+enum agent_op {
+	AGENT_ADD = 0x02,
+	AGENT_SUB = 0x03,
+	AGENT_MUL = 0x04,
+	AGENT_DIV_SIGNED = 0x05,
+	AGENT_DIV_UNSIGNED = 0x06,
+	AGENT_REM_SIGNED = 0x07,
+	AGENT_REM_UNSIGNED = 0x08,
+	AGENT_LSH = 0x09,
+	AGENT_RSH_SIGNED = 0x0a,
+	AGENT_RSH_UNSIGNED = 0x0b,
+	AGENT_TRACE = 0x0c,
+	AGENT_TRACE_QUICK = 0x0d,
+	AGENT_LOG_NOT = 0x0e,
+	AGENT_BIT_AND = 0x0f,
+	AGENT_BIT_OR = 0x10,
+	AGENT_BIT_XOR = 0x11,
+	AGENT_BIT_NOT = 0x12,
+	AGENT_EQUAL = 0x13,
+	AGENT_LESS_SIGNED = 0x14,
+	AGENT_LESS_UNSIGNED = 0x15,
+	AGENT_EXT = 0x16,
+	AGENT_REF8 = 0x17,
+	AGENT_REF16 = 0x18,
+	AGENT_REF32 = 0x19,
+	AGENT_REF64 = 0x1a,
+	AGENT_IF_GOTO = 0x20,
+	AGENT_GOTO = 0x21,
+	AGENT_CONST8 = 0x22,
+	AGENT_CONST16 = 0x23,
+	AGENT_CONST32 = 0x24,
+	AGENT_CONST64 = 0x25,
+	AGENT_REG = 0x26,
+	AGENT_END = 0x27,
+	AGENT_DUP = 0x28,
+	AGENT_POP = 0x29,
+	AGENT_ZERO_EXT = 0x2a,
+	AGENT_SWAP = 0x2b,
+	AGENT_TRACENZ = 0x2f,
+	AGENT_TRACE16 = 0x30,
+	AGENT_PICK = 0x32,
+	AGENT_ROT = 0x33,
+};
+
+struct agent_expr *agent_expr_new(const uint8_t *code, size_t len,
+                                  struct agent_expr *next)
+{
+	struct agent_expr *x = malloc(sizeof(*x) + len);
+
+	if (!x) {
+		DEBUG("malloc: failed in %s\n", __func__);
+		return NULL;
+	}
+	x->next = next;
+	x->len = len;
+	memcpy(x->code, code, len);
+	return x;
+}
+
+void agent_expr_free(struct agent_expr *x)
+{
+	while (x) {
+		struct agent_expr *next = x->next;
+		free(x);
+		x = next;
+	}
+}
+
+/* Fetch a big endian immediate of n bytes following the bytecode at pc */
+static bool agent_fetch(const struct agent_expr *x, size_t pc, size_t n,
+                        uint64_t *val)
+{
+	if (pc + n >= x->len)
+		return false;
+	*val = 0;
+	for (size_t i = 1; i <= n; i++)
+		*val = (*val << 8) | x->code[pc + i];
+	return true;
+}
+
+static uint64_t agent_sign_extend(uint64_t val, unsigned bits)
+{
+	if ((bits == 0) || (bits >= 64))
+		return val;
+	uint64_t sign = 1ULL << (bits - 1);
+	val &= (sign << 1) - 1;
+	return (val ^ sign) - sign;
+}
+
+static uint64_t agent_zero_extend(uint64_t val, unsigned bits)
+{
+	if ((bits == 0) || (bits >= 64))
+		return val;
+	return val & ((1ULL << bits) - 1);
+}
+
+/* Length of the NUL terminated string at addr, including the NUL, but
+ * at most max. Returns -1 if the memory can't be read. */
+static ssize_t agent_strnlen(target *t, target_addr addr, size_t max)
+{
+	uint8_t buf[32];
+
+	for (size_t len = 0; len < max; len += sizeof(buf)) {
+		size_t n = MIN(sizeof(buf), max - len);
+		if (target_mem_read(t, buf, addr + len, n))
+			return -1;
+		uint8_t *nul = memchr(buf, 0, n);
+		if (nul)
+			return len + (nul - buf) + 1;
+	}
+	return max;
+}
+
+int agent_expr_eval(target *t, const struct agent_expr *x, uint64_t *result,
+                    agent_trace_func trace, void *arg)
+{
+	uint64_t stack[AGENT_STACK_SIZE];
+	int sp = 0;		/* Number of items on the stack */
+	size_t pc = 0;
+	uint64_t imm, a, b;
+	uint8_t buf[8];
+
+/* Operand checks, each ends the evaluation with an error */
+#define NEED(n)		do { if (sp < (n)) goto underflow; } while (0)
+#define ROOM(n)		do { if (sp + (n) > AGENT_STACK_SIZE) goto overflow; } while (0)
+#define FETCH(n)	do { if (!agent_fetch(x, pc, (n), &imm)) goto truncated; } while (0)
+#define TOP		stack[sp - 1]
+#define TRACE(addr, len)	do { \
+		if (!trace) goto no_trace; \
+		if (!trace(arg, (addr), (len))) return -1; \
+	} while (0)
+
+	for (unsigned steps = 0; steps < AGENT_MAX_STEPS; steps++) {
+		if (pc >= x->len)
+			goto truncated;
+		uint8_t op = x->code[pc];
+		size_t next = pc + 1;
+
+		switch (op) {
+		case AGENT_ADD: case AGENT_SUB: case AGENT_MUL:
+		case AGENT_DIV_SIGNED: case AGENT_DIV_UNSIGNED:
+		case AGENT_REM_SIGNED: case AGENT_REM_UNSIGNED:
+		case AGENT_LSH: case AGENT_RSH_SIGNED: case AGENT_RSH_UNSIGNED:
+		case AGENT_BIT_AND: case AGENT_BIT_OR: case AGENT_BIT_XOR:
+		case AGENT_EQUAL: case AGENT_LESS_SIGNED: case AGENT_LESS_UNSIGNED:
+			NEED(2);
+			b = stack[--sp];
+			a = TOP;
+			switch (op) {
+			case AGENT_ADD: a += b; break;
+			case AGENT_SUB: a -= b; break;
+			case AGENT_MUL: a *= b; break;
+			case AGENT_DIV_SIGNED:
+				if (!b)
+					goto div_zero;
+				/* INT64_MIN / -1 overflows and traps on x86 */
+				if (b == (uint64_t)-1)
+					a = -a;
+				else
+					a = (int64_t)a / (int64_t)b;
+				break;
+			case AGENT_DIV_UNSIGNED:
+				if (!b)
+					goto div_zero;
+				a /= b;
+				break;
+			case AGENT_REM_SIGNED:
+				if (!b)
+					goto div_zero;
+				if (b == (uint64_t)-1)
+					a = 0;
+				else
+					a = (int64_t)a % (int64_t)b;
+				break;
+			case AGENT_REM_UNSIGNED:
+				if (!b)
+					goto div_zero;
+				a %= b;
+				break;
+			case AGENT_LSH: a = (b < 64) ? a << b : 0; break;
+			case AGENT_RSH_SIGNED:
+				a = (int64_t)a >> MIN(b, 63);
+				break;
+			case AGENT_RSH_UNSIGNED: a = (b < 64) ? a >> b : 0; break;
+			case AGENT_BIT_AND: a &= b; break;
+			case AGENT_BIT_OR: a |= b; break;
+			case AGENT_BIT_XOR: a ^= b; break;
+			case AGENT_EQUAL: a = (a == b); break;
+			case AGENT_LESS_SIGNED: a = ((int64_t)a < (int64_t)b); break;
+			case AGENT_LESS_UNSIGNED: a = (a < b); break;
+			}
+			TOP = a;
+			break;
+
+		case AGENT_LOG_NOT:
+			NEED(1);
+			TOP = !TOP;
+			break;
+		case AGENT_BIT_NOT:
+			NEED(1);
+			TOP = ~TOP;
+			break;
+		case AGENT_EXT:
+		case AGENT_ZERO_EXT:
+			FETCH(1);
+			NEED(1);
+			TOP = (op == AGENT_EXT) ? agent_sign_extend(TOP, imm) :
+			                          agent_zero_extend(TOP, imm);
+			next += 1;
+			break;
+
+		case AGENT_REF8: case AGENT_REF16:
+		case AGENT_REF32: case AGENT_REF64: {
+			size_t n = 1 << (op - AGENT_REF8);
+			NEED(1);
+			if (target_mem_read(t, buf, TOP, n)) {
+				DEBUG("agent: can't read 0x%08" PRIx32 "\n",
+				      (uint32_t)TOP);
+				return -1;
+			}
+			/* Target memory is little endian */
+			TOP = 0;
+			while (n--)
+				TOP = (TOP << 8) | buf[n];
+			break;
+		}
+
+		case AGENT_TRACE:
+			NEED(2);
+			sp -= 2;
+			TRACE(stack[sp], stack[sp + 1]);
+			break;
+		case AGENT_TRACE_QUICK:
+		case AGENT_TRACE16:
+			FETCH((op == AGENT_TRACE16) ? 2 : 1);
+			NEED(1);
+			TRACE(TOP, imm);
+			next += (op == AGENT_TRACE16) ? 2 : 1;
+			break;
+		case AGENT_TRACENZ: {
+			NEED(2);
+			sp -= 2;
+			ssize_t len = agent_strnlen(t, stack[sp], stack[sp + 1]);
+			if (len < 0)
+				return -1;
+			TRACE(stack[sp], len);
+			break;
+		}
+
+		case AGENT_IF_GOTO:
+			FETCH(2);
+			NEED(1);
+			next = stack[--sp] ? imm : pc + 3;
+			break;
+		case AGENT_GOTO:
+			FETCH(2);
+			next = imm;
+			break;
+
+		case AGENT_CONST8: case AGENT_CONST16:
+		case AGENT_CONST32: case AGENT_CONST64: {
+			size_t n = 1 << (op - AGENT_CONST8);
+			FETCH(n);
+			ROOM(1);
+			stack[sp++] = imm;
+			next += n;
+			break;
+		}
+
+		case AGENT_REG: {
+			FETCH(2);
+			ROOM(1);
+			memset(buf, 0, sizeof(buf));
+			ssize_t n = target_reg_read(t, imm, buf, sizeof(buf));
+			if (n <= 0) {
+				DEBUG("agent: can't read register %d\n", (int)imm);
+				return -1;
+			}
+			a = 0;
+			while (n--)
+				a = (a << 8) | buf[n];
+			stack[sp++] = a;
+			next += 2;
+			break;
+		}
+
+		case AGENT_END:
+			/* Collection expressions may leave nothing behind */
+			*result = sp ? TOP : 0;
+			return 0;
+
+		case AGENT_DUP:
+			NEED(1);
+			ROOM(1);
+			stack[sp] = TOP;
+			sp++;
+			break;
+		case AGENT_POP:
+			NEED(1);
+			sp--;
+			break;
+		case AGENT_SWAP:
+			NEED(2);
+			a = TOP;
+			TOP = stack[sp - 2];
+			stack[sp - 2] = a;
+			break;
+		case AGENT_PICK:
+			FETCH(1);
+			NEED((int)imm + 1);
+			ROOM(1);
+			stack[sp] = stack[sp - 1 - imm];
+			sp++;
+			next += 1;
+			break;
+		case AGENT_ROT:
+			/* a b c => c a b */
+			NEED(3);
+			a = stack[sp - 3];
+			b = stack[sp - 2];
+			stack[sp - 3] = TOP;
+			stack[sp - 2] = a;
+			TOP = b;
+			break;
+
+		default:
+			DEBUG("agent: unsupported bytecode 0x%02x at %u\n",
+			      op, (unsigned)pc);
+			return -1;
+		}
+		pc = next;
+	}
+	DEBUG("agent: step limit reached\n");
+	return -1;
+
+underflow:
+	DEBUG("agent: stack underflow at %u\n", (unsigned)pc);
+	return -1;
+overflow:
+	DEBUG("agent: stack overflow at %u\n", (unsigned)pc);
+	return -1;
+truncated:
+	DEBUG("agent: truncated expression at %u\n", (unsigned)pc);
+	return -1;
+div_zero:
+	DEBUG("agent: division by zero at %u\n", (unsigned)pc);
+	return -1;
+no_trace:
+	DEBUG("agent: trace bytecode outside of a tracepoint at %u\n",
+	      (unsigned)pc);
+	return -1;
+#undef NEED
+#undef ROOM
+#undef FETCH
+#undef TOP
+#undef TRACE
+}
@@ -40,9 +40,11 @@ he terms of the GNU General Public License as published by
 static const char cortexm_driver_str[] = "ARM Cortex-M";
 
 static bool cortexm_vector_catch(target *t, int argc, char *argv[]);
+static bool cortexm_semihost_direct(target *t, int argc, const char **argv);
 
 const struct command_s cortexm_cmd_list[] = {
 	{"vector_catch", (cmd_handler)cortexm_vector_catch, "Catch exception vectors"},
+	{"semihost_direct", (cmd_handler)cortexm_semihost_direct, "Send semihosting console output straight to the GDB console: (enable|disable)"},
 	{NULL, NULL, NULL}
 };
 
@@ -83,9 +85,16 @@ struct cortexm_priv {
 	unsigned hw_breakpoint_max;
 	/* Copy of DEMCR for vector-catch */
 	uint32_t demcr;
+	/* Semihosting console writes bypass GDB File-I/O */
+	bool semihost_direct;
 	/* Cache parameters */
 	bool has_cache;
 	uint32_t dcache_minline;
+#if defined(STLINKV2)
+	/* FP registers (fpscr, s0-s31) as last read from or written to the core */
+	bool fp_valid;
+	uint32_t fp_regs[33];
+#endif
 };
 
 /* Register number tables */
@@ -230,6 +239,32 @@ static void cortexm_mem_write(target *t, target_addr dest, const void *src, size
 	adiv5_mem_write(cortexm_ap(t), dest, src, len);
 }
 
+static void cortexm_mem_read32_batch(target *t, struct target_mem32 *ops, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		cortexm_cache_clean(t, ops[i].addr, 4, false);
+	adiv5_mem_read32_batch(cortexm_ap(t), ops, n);
+}
+
+static void cortexm_mem_write32_batch(target *t, const struct target_mem32 *ops, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		cortexm_cache_clean(t, ops[i].addr, 4, true);
+	adiv5_mem_write32_batch(cortexm_ap(t), ops, n);
+}
+
+static bool cortexm_mem_poll32(target *t, target_addr addr, uint32_t mask,
+                               uint32_t value, uint32_t timeout_ms,
+                               uint32_t *result)
+{
+	cortexm_cache_clean(t, addr, 4, false);
+	return adiv5_mem_poll32(cortexm_ap(t), addr, mask, value, timeout_ms,
+	                        result);
+}
+
+static bool cortexm_mem_crc32(target *t, target_addr base, size_t len,
+                              uint32_t *crc);
+
 static bool cortexm_check_error(target *t)
 {
 	ADIv5_AP_t *ap = cortexm_ap(t);
@@ -286,6 +321,10 @@ bool cortexm_probe(ADIv5_AP_t *ap, bool forced)
 	t->check_error = cortexm_check_error;
 	t->mem_read = cortexm_mem_read;
 	t->mem_write = cortexm_mem_write;
+	t->mem_read32_batch = cortexm_mem_read32_batch;
+	t->mem_write32_batch = cortexm_mem_write32_batch;
+	t->mem_poll32 = cortexm_mem_poll32;
+	t->mem_crc32 = cortexm_mem_crc32;
 
 	t->driver = cortexm_driver_str;
 	switch (identity) {
@@ -318,6 +357,7 @@ bool cortexm_probe(ADIv5_AP_t *ap, bool forced)
 	t->halt_poll = cortexm_halt_poll;
 	t->halt_resume = cortexm_halt_resume;
 	t->regs_size = sizeof(regnum_cortex_m);
+	t->reg_size = 4;
 
 	t->breakwatch_set = cortexm_breakwatch_set;
 	t->breakwatch_clear = cortexm_breakwatch_clear;
@@ -458,15 +498,24 @@ static void cortexm_regs_read(target *t, void *data)
 	ADIv5_AP_t *ap = cortexm_ap(t);
 	unsigned i;
 #if defined(STLINKV2)
+	struct cortexm_priv *priv = t->priv;
 	uint32_t base_regs[21];
 	extern void stlink_regs_read(ADIv5_AP_t *ap, void *data);
-	extern uint32_t stlink_reg_read(ADIv5_AP_t *ap, int idx);
+	extern void stlink_regs_read_list(ADIv5_AP_t *ap, const uint32_t *regnum,
+									  int n, uint32_t *data);
 	stlink_regs_read(ap, base_regs);
 	for(i = 0; i < sizeof(regnum_cortex_m) / 4; i++)
 		*regs++ = base_regs[regnum_cortex_m[i]];
-	if (t->target_options & TOPT_FLAVOUR_V7MF)
-		for(size_t t = 0; t < sizeof(regnum_cortex_mf) / 4; t++)
-			*regs++ = stlink_reg_read(ap, regnum_cortex_mf[t]);
+	if (t->target_options & TOPT_FLAVOUR_V7MF) {
+		/* Fetched once per halt, the cache is dropped on resume */
+		if (!priv->fp_valid) {
+			stlink_regs_read_list(ap, regnum_cortex_mf,
+			                      sizeof(regnum_cortex_mf) / 4,
+			                      priv->fp_regs);
+			priv->fp_valid = true;
+		}
+		memcpy(regs, priv->fp_regs, sizeof(priv->fp_regs));
+	}
 #else
 	/* FIXME: Describe what's really going on here */
 	adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_SIZE_WORD);
@@ -499,15 +548,27 @@ static void cortexm_regs_write(target *t, const void *data)
 	const uint32_t *regs = data;
 	ADIv5_AP_t *ap = cortexm_ap(t);
 #if defined(STLINKV2)
-	extern void stlink_reg_write(ADIv5_AP_t *ap, int num, uint32_t val);
-	for(size_t z = 0; z < sizeof(regnum_cortex_m) / 4; z++) {
-		stlink_reg_write(ap, regnum_cortex_m[z], *regs);
-		regs++;
-	}
-	if (t->target_options & TOPT_FLAVOUR_V7MF)
+	struct cortexm_priv *priv = t->priv;
+	extern void stlink_regs_write_list(ADIv5_AP_t *ap, const uint32_t *regnum,
+									   int n, const uint32_t *data);
+	stlink_regs_write_list(ap, regnum_cortex_m, sizeof(regnum_cortex_m) / 4,
+	                       regs);
+	regs += sizeof(regnum_cortex_m) / 4;
+	if (t->target_options & TOPT_FLAVOUR_V7MF) {
+		/* Only write back FP registers that differ from the core */
+		uint32_t regnum[sizeof(regnum_cortex_mf) / 4];
+		uint32_t val[sizeof(regnum_cortex_mf) / 4];
+		int n = 0;
 		for(size_t z = 0; z < sizeof(regnum_cortex_mf) / 4; z++) {
-			stlink_reg_write(ap, regnum_cortex_mf[z], *regs);
-			regs++;
+			if (priv->fp_valid && (priv->fp_regs[z] == regs[z]))
+				continue;
+			regnum[n] = regnum_cortex_mf[z];
+			val[n++] = regs[z];
+			priv->fp_regs[z] = regs[z];
+		}
+		if (n)
+			stlink_regs_write_list(ap, regnum, n, val);
+		priv->fp_valid = true;
 	}
 #else
 	unsigned i;
@@ -579,6 +640,9 @@ ssize_t cortexm_reg_write(target *t, int reg, const void *data, size_t max)
 	target_mem_write32(t, CORTEXM_DCRDR, *r);
 	target_mem_write32(t, CORTEXM_DCRSR, CORTEXM_DCRSR_REGWnR |
 	                                     dcrsr_regnum(t, reg));
+#if defined(STLINKV2)
+	((struct cortexm_priv *)t->priv)->fp_valid = false;
+#endif
 	return 4;
 }
 
@@ -598,6 +662,9 @@ static void cortexm_pc_write(target *t, const uint32_t val)
  * using the core debug registers in the NVIC. */
 static void cortexm_reset(target *t)
 {
+#if defined(STLINKV2)
+	((struct cortexm_priv *)t->priv)->fp_valid = false;
+#endif
 	if ((t->target_options & CORTEXM_TOPT_INHIBIT_SRST) == 0) {
 		platform_srst_set_val(true);
 		platform_srst_set_val(false);
@@ -729,6 +796,9 @@ void cortexm_halt_resume(target *t, bool step)
 	if (priv->has_cache)
 		target_mem_write32(t, CORTEXM_ICIALLU, 0);
 
+#if defined(STLINKV2)
+	priv->fp_valid = false;
+#endif
 	target_mem_write32(t, CORTEXM_DHCSR, dhcsr);
 }
 
@@ -791,19 +861,42 @@ static int cortexm_fault_unwind(target *t)
 	return 0;
 }
 
-int cortexm_run_stub(target *t, uint32_t loadaddr,
-                     uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+/* Stack pointer for a stub: the main stack pointer of the core if it
+ * points to RAM, otherwise the top of the RAM region holding the stub */
+static uint32_t cortexm_stub_sp(target *t, uint32_t msp, uint32_t loadaddr)
+{
+	struct target_ram *stub = NULL;
+
+	for (struct target_ram *r = t->ram; r; r = r->next) {
+		if ((msp > r->start) && (msp - r->start <= r->length))
+			return msp & ~7;
+		if ((loadaddr >= r->start) && (loadaddr - r->start < r->length))
+			stub = r;
+	}
+	return stub ? (stub->start + stub->length) & ~7 : msp;
+}
+
+/* The stub may interrupt a live application, so it runs with PRIMASK set
+ * and on the application's main stack. A pending interrupt would
+ * otherwise run the application's handler. */
+int cortexm_start_stub(target *t, uint32_t loadaddr,
+                       uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
 	uint32_t regs[t->regs_size / 4];
 
+	target_regs_cache_flush(t);
+	cortexm_regs_read(t, regs);
+	uint32_t sp = cortexm_stub_sp(t, regs[REG_MSP], loadaddr);
 	memset(regs, 0, sizeof(regs));
 	regs[0] = r0;
 	regs[1] = r1;
 	regs[2] = r2;
 	regs[3] = r3;
-	regs[15] = loadaddr;
-	regs[16] = 0x1000000;
-	regs[19] = 0;
+	regs[REG_SP] = sp;
+	regs[REG_PC] = loadaddr;
+	regs[REG_XPSR] = 0x1000000;
+	regs[REG_MSP] = sp;
+	regs[REG_SPECIAL] = CORTEXM_SPECIAL_PRIMASK;
 
 	cortexm_regs_write(t, regs);
 
@@ -811,10 +904,28 @@ int cortexm_run_stub(target *t, uint32_t loadaddr,
 		return -1;
 
 	/* Execute the stub */
-	enum target_halt_reason reason;
 	cortexm_halt_resume(t, 0);
-	while ((reason = cortexm_halt_poll(t, NULL)) == TARGET_HALT_RUNNING)
-		;
+	return 0;
+}
+
+int cortexm_wait_stub(target *t)
+{
+	enum target_halt_reason reason;
+	platform_timeout timeout;
+
+	platform_timeout_set(&timeout, CORTEXM_STUB_TIMEOUT_MS);
+	while ((reason = cortexm_halt_poll(t, NULL)) == TARGET_HALT_RUNNING) {
+		if (platform_timeout_is_expired(&timeout)) {
+			DEBUG("Stub timed out\n");
+			cortexm_halt_request(t);
+			platform_timeout_set(&timeout, cortexm_wait_timeout);
+			while (cortexm_halt_poll(t, NULL) == TARGET_HALT_RUNNING)
+				if (platform_timeout_is_expired(&timeout))
+					raise_exception(EXCEPTION_ERROR,
+					                "Target lost in stub");
+			return -2;
+		}
+	}
 
 	if (reason == TARGET_HALT_ERROR)
 		raise_exception(EXCEPTION_ERROR, "Target lost in stub");
@@ -830,6 +941,67 @@ int cortexm_run_stub(target *t, uint32_t loadaddr,
 	return bkpt_instr & 0xff;
 }
 
+int cortexm_run_stub(target *t, uint32_t loadaddr,
+                     uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+	if (cortexm_start_stub(t, loadaddr, r0, r1, r2, r3))
+		return -1;
+	return cortexm_wait_stub(t);
+}
+
+target_addr cortexm_stub_ram(target *t, size_t len)
+{
+	/* Code can only be executed from the SRAM region */
+	for (struct target_ram *r = t->ram; r; r = r->next)
+		if ((r->start >= CORTEXM_SRAM_BASE) &&
+		    (r->start < CORTEXM_SRAM_END) && (r->length >= len))
+			return r->start;
+	return 0;
+}
+
+static const uint16_t cortexm_crc32_stub[] = {
+#include "flashstub/crc32.stub"
+};
+
+/* Below this, reading the memory is cheaper than running the stub */
+#define CORTEXM_CRC32_STUB_MIN	512
+
+/* Run the CRC32 stub on the halted core, so that only the result crosses
+ * the wire. Registers and the RAM under the stub are restored. */
+static bool cortexm_mem_crc32(target *t, target_addr base, size_t len,
+                              uint32_t *crc)
+{
+	struct cortexm_priv *priv = t->priv;
+
+	if (len < CORTEXM_CRC32_STUB_MIN)
+		return false;
+	if (!(target_mem_read32(t, CORTEXM_DHCSR) & CORTEXM_DHCSR_S_HALT))
+		return false;
+	target_addr loadaddr = cortexm_stub_ram(t, sizeof(cortexm_crc32_stub));
+	if (!loadaddr)
+		return false;
+
+	uint32_t regs[t->regs_size / 4];
+	uint8_t saved[sizeof(cortexm_crc32_stub)];
+	bool on_bkpt = priv->on_bkpt;
+	target_regs_cache_flush(t);
+	cortexm_regs_read(t, regs);
+	target_mem_read(t, saved, loadaddr, sizeof(saved));
+	if (target_check_error(t))
+		return false;
+
+	target_mem_write(t, loadaddr, cortexm_crc32_stub,
+	                 sizeof(cortexm_crc32_stub));
+	int ret = cortexm_run_stub(t, loadaddr, 0xffffffff, base, len, 0);
+	if (ret == 0)
+		cortexm_reg_read(t, 0, crc, sizeof(*crc));
+
+	target_mem_write(t, loadaddr, saved, sizeof(saved));
+	cortexm_regs_write(t, regs);
+	priv->on_bkpt = on_bkpt;
+	return (ret == 0) && !target_check_error(t);
+}
+
 /* The following routines implement hardware breakpoints and watchpoints.
  * The Flash Patch and Breakpoint (FPB) and Data Watch and Trace (DWT)
  * systems are used. */
@@ -995,6 +1167,17 @@ static bool cortexm_vector_catch(target *t, int argc, char *argv[])
 	return true;
 }
 
+static bool cortexm_semihost_direct(target *t, int argc, const char **argv)
+{
+	struct cortexm_priv *priv = t->priv;
+
+	if (argc > 1)
+		parse_enable_or_disable(argv[1], &priv->semihost_direct);
+	tc_printf(t, "Direct semihosting console output: %s\n",
+	          priv->semihost_direct ? "enabled" : "disabled");
+	return true;
+}
+
 /* Windows defines this with some other meaning... */
 #ifdef SYS_OPEN
 #	undef SYS_OPEN
@@ -1025,8 +1208,64 @@ static bool cortexm_vector_catch(target *t, int argc, char *argv[])
 #define SYS_WRITEC	0x03
 #define SYS_WRITE0	0x04
 
+/* Console output is read and sent in pieces of this size */
+#define CORTEXM_HOSTIO_CHUNK	128
+
+/* End of the RAM or flash region holding addr, 0 if there is none */
+static target_addr cortexm_region_end(target *t, target_addr addr)
+{
+	for (struct target_ram *r = t->ram; r; r = r->next)
+		if ((addr >= r->start) && (addr - r->start < r->length))
+			return r->start + r->length;
+	for (struct target_flash *f = t->flash; f; f = f->next)
+		if ((addr >= f->start) && (addr - f->start < f->length))
+			return f->start + f->length;
+	return 0;
+}
+
+/* Copy len bytes at addr to the GDB console as O packets, without a File-I/O
+ * round trip. With string set, output ends at the first NUL. Returns the
+ * number of bytes not written. */
+static uint32_t cortexm_hostio_console(target *t, target_addr addr,
+                                       uint32_t len, bool string)
+{
+	char buf[CORTEXM_HOSTIO_CHUNK];
+
+	while (len) {
+		size_t n = MIN(len, CORTEXM_HOSTIO_CHUNK);
+		if (string) {
+			/* The string's length is unknown: don't read past the
+			 * end of its region, or of an aligned chunk when it is
+			 * in no known region */
+			target_addr end = cortexm_region_end(t, addr);
+			if (!end)
+				end = (addr | (CORTEXM_HOSTIO_CHUNK - 1)) + 1;
+			n = MIN(n, end - addr);
+		}
+		if (target_mem_read(t, buf, addr, n))
+			break;
+		if (string) {
+			const char *nul = memchr(buf, '\0', n);
+			if (nul) {
+				tc_console(t, buf, nul - buf);
+				return 0;
+			}
+		}
+		tc_console(t, buf, n);
+		addr += n;
+		len -= n;
+	}
+	return len;
+}
+
+static bool cortexm_hostio_is_console(uint32_t handle)
+{
+	return (handle - 1 == STDOUT_FILENO) || (handle - 1 == STDERR_FILENO);
+}
+
 static int cortexm_hostio_request(target *t)
 {
+	struct cortexm_priv *priv = t->priv;
 	uint32_t arm_regs[t->regs_size];
 	uint32_t params[4];
 
@@ -1035,6 +1274,8 @@ static int cortexm_hostio_request(target *t)
 	target_mem_read(t, params, arm_regs[1], sizeof(params));
 	uint32_t syscall = arm_regs[0];
 	int32_t ret = 0;
+	/* Without File-I/O console output has to go the direct way */
+	bool direct = priv->semihost_direct || t->tc->no_fileio;
 
 	DEBUG("syscall 0"PRIx32"%"PRIx32" (%"PRIx32" %"PRIx32" %"PRIx32" %"PRIx32")\n",
               syscall, params[0], params[1], params[2], params[3]);
@@ -1080,12 +1321,22 @@ static int cortexm_hostio_request(target *t)
 			ret = params[2] - ret;
 		break;
 	case SYS_WRITE:	/* write */
+		if (direct && cortexm_hostio_is_console(params[0])) {
+			ret = cortexm_hostio_console(t, params[1], params[2], false);
+			break;
+		}
 		ret = tc_write(t, params[0] - 1, params[1], params[2]);
 		if (ret > 0)
 			ret = params[2] - ret;
 		break;
 	case SYS_WRITEC: /* writec */
-		ret = tc_write(t, 2, arm_regs[1], 1);
+		if (direct)
+			cortexm_hostio_console(t, arm_regs[1], 1, false);
+		else
+			ret = tc_write(t, 2, arm_regs[1], 1);
+		break;
+	case SYS_WRITE0: /* write0, there is no File-I/O equivalent */
+		cortexm_hostio_console(t, arm_regs[1], UINT32_MAX, true);
 		break;
 	case SYS_ISTTY:	/* isatty */
 		ret = tc_isatty(t, params[0] - 1);
@@ -23,6 +23,10 @@
 #include "adiv5.h"
 
 extern long cortexm_wait_timeout;
+/* Code region accessible through the system bus */
+#define CORTEXM_SRAM_BASE	0x20000000
+#define CORTEXM_SRAM_END	0x40000000
+
 /* Private peripheral bus base address */
 #define CORTEXM_PPB_BASE	0xE0000000
 
@@ -166,6 +170,12 @@ extern long cortexm_wait_timeout;
 #define REG_PSP		18
 #define REG_SPECIAL	19
 
+/* The special register packs CONTROL, FAULTMASK, BASEPRI and PRIMASK */
+#define CORTEXM_SPECIAL_PRIMASK	(1 << 0)
+
+/* Longest a stub may run before it is halted */
+#define CORTEXM_STUB_TIMEOUT_MS	10000
+
 #define ARM_THUMB_BREAKPOINT 0xBE00
 
 #define	CORTEXM_TOPT_INHIBIT_SRST (1 << 2)
@@ -178,6 +188,13 @@ void cortexm_detach(target *t);
 void cortexm_halt_resume(target *t, bool step);
 int cortexm_run_stub(target *t, uint32_t loadaddr,
                      uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+/* Start a stub without waiting for it, and wait for it to hit a BKPT.
+ * cortexm_wait_stub() returns the BKPT immediate like cortexm_run_stub(). */
+int cortexm_start_stub(target *t, uint32_t loadaddr,
+                       uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+int cortexm_wait_stub(target *t);
+/* Start of a RAM region able to hold len bytes of stub code, or 0 */
+target_addr cortexm_stub_ram(target *t, size_t len);
 int cortexm_mem_write_sized(
 	target *t, target_addr dest, const void *src, size_t len, enum align align);
 
@@ -0,0 +1,183 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file implements the host side of the double buffered flash
+ * loader. See flashloader.h for the mailbox protocol.
+ */
+
+#include "general.h"
+#include "target.h"
+#include "target_internal.h"
+#include "cortexm.h"
+#include "flashloader.h"
+
+/* Upper bound for the stub to program one buffer */
+#define FLASHLOADER_TIMEOUT_MS	2000
+/* Slice length for polling a slot, status is checked in between */
+#define FLASHLOADER_POLL_MS	20
+
+static int flashloader_erase(struct target_flash *f,
+                             target_addr addr, size_t len);
+static int flashloader_write(struct target_flash *f,
+                             target_addr dest, const void *src, size_t len);
+static int flashloader_done(struct target_flash *f);
+
+void flashloader_add_flash(target *t, struct flashloader_flash *lf)
+{
+	lf->erase = lf->f.erase;
+	lf->write = lf->f.write;
+	lf->done = lf->f.done;
+	lf->f.erase = flashloader_erase;
+	lf->f.write = flashloader_write;
+	lf->f.done = flashloader_done;
+	lf->running = false;
+	target_add_flash(t, &lf->f);
+}
+
+static bool flashloader_start(struct flashloader_flash *lf)
+{
+	target *t = lf->f.t;
+	size_t stub_size = ALIGN(lf->loader->stub_size, 4);
+	size_t buf_size = ALIGN(lf->f.buf_size, 4);
+	size_t need = stub_size + FLASHLOADER_MAILBOX_SIZE + 2 * buf_size;
+	target_addr base = cortexm_stub_ram(t, need);
+
+	if (!base) {
+		DEBUG("flashloader: no RAM for %" PRIu32 " bytes\n", (uint32_t)need);
+		return false;
+	}
+
+	lf->mailbox = base + stub_size;
+	lf->buf[0] = lf->mailbox + FLASHLOADER_MAILBOX_SIZE;
+	lf->buf[1] = lf->buf[0] + buf_size;
+	struct target_mem32 mbox[] = {
+		{lf->mailbox + FLASHLOADER_SLOT(0) + FLASHLOADER_SLOT_LEN, 0},
+		{lf->mailbox + FLASHLOADER_SLOT(0) + FLASHLOADER_SLOT_SRC, lf->buf[0]},
+		{lf->mailbox + FLASHLOADER_SLOT(1) + FLASHLOADER_SLOT_LEN, 0},
+		{lf->mailbox + FLASHLOADER_SLOT(1) + FLASHLOADER_SLOT_SRC, lf->buf[1]},
+		{lf->mailbox + FLASHLOADER_STOP, 0},
+		{lf->mailbox + FLASHLOADER_STATUS, 0},
+	};
+
+	target_mem_write(t, base, lf->loader->stub, lf->loader->stub_size);
+	if (target_mem_write32_batch(t, mbox, ARRAY_NUMELEM(mbox)))
+		return false;
+	if (cortexm_start_stub(t, base, lf->mailbox,
+	                       lf->args[0], lf->args[1], lf->args[2]))
+		return false;
+	lf->slot = 0;
+	lf->running = true;
+	return true;
+}
+
+/* Wait for the stub to hand back buffer n. Returns 0 when it is free,
+ * 1 on timeout and -1 if the stub reported an error. */
+static int flashloader_wait(struct flashloader_flash *lf, unsigned n)
+{
+	target *t = lf->f.t;
+	target_addr len = lf->mailbox + FLASHLOADER_SLOT(n) + FLASHLOADER_SLOT_LEN;
+	platform_timeout timeout;
+
+	platform_timeout_set(&timeout, FLASHLOADER_TIMEOUT_MS);
+	do {
+		int res = target_mem_poll32(t, len, 0xffffffff, 0,
+		                            FLASHLOADER_POLL_MS, NULL);
+		if (res <= 0)
+			return res;
+		if (target_mem_read32(t, lf->mailbox + FLASHLOADER_STATUS))
+			return -1;
+	} while (!platform_timeout_is_expired(&timeout));
+	return 1;
+}
+
+/* Stop the stub, after letting it program all pending buffers if drain
+ * is set. Leaves the target halted. */
+static int flashloader_stop(struct flashloader_flash *lf, bool drain)
+{
+	target *t = lf->f.t;
+
+	lf->running = false;
+	if (drain)
+		drain = !flashloader_wait(lf, lf->slot) &&
+		        !flashloader_wait(lf, lf->slot ^ 1);
+	if (drain)
+		target_mem_write32(t, lf->mailbox + FLASHLOADER_STOP, 1);
+	else
+		target_halt_request(t);
+
+	int ret = cortexm_wait_stub(t);
+	if (drain && (ret == 0))
+		return 0;
+	DEBUG("flashloader: stub stopped with %d, status 0x%08" PRIx32 "\n",
+	      ret, target_mem_read32(t, lf->mailbox + FLASHLOADER_STATUS));
+	return -1;
+}
+
+static int flashloader_write(struct target_flash *f,
+                             target_addr dest, const void *src, size_t len)
+{
+	struct flashloader_flash *lf = (struct flashloader_flash *)f;
+	target *t = f->t;
+
+	if (!lf->running &&
+	    ((len > f->buf_size) || !flashloader_start(lf)))
+		return lf->write(f, dest, src, len);
+
+	target_addr slot = lf->mailbox + FLASHLOADER_SLOT(lf->slot);
+	if (flashloader_wait(lf, lf->slot)) {
+		flashloader_stop(lf, false);
+		return -1;
+	}
+	target_mem_write(t, lf->buf[lf->slot], src, len);
+	/* Writing len hands the buffer to the stub, so it goes last */
+	struct target_mem32 ops[] = {
+		{slot + FLASHLOADER_SLOT_DEST, dest},
+		{slot + FLASHLOADER_SLOT_LEN, len},
+	};
+	lf->slot ^= 1;
+	if (target_mem_write32_batch(t, ops, ARRAY_NUMELEM(ops))) {
+		flashloader_stop(lf, false);
+		return -1;
+	}
+	return 0;
+}
+
+/* Erases may be interleaved with writes in incremental mode. The stub
+ * must not touch the flash controller meanwhile. */
+static int flashloader_erase(struct target_flash *f,
+                             target_addr addr, size_t len)
+{
+	struct flashloader_flash *lf = (struct flashloader_flash *)f;
+
+	if (lf->running && flashloader_stop(lf, true))
+		return -1;
+	return lf->erase(f, addr, len);
+}
+
+static int flashloader_done(struct target_flash *f)
+{
+	struct flashloader_flash *lf = (struct flashloader_flash *)f;
+	int ret = 0;
+
+	if (lf->running)
+		ret = flashloader_stop(lf, true);
+	if (!ret && lf->done)
+		ret = lf->done(f);
+	return ret;
+}
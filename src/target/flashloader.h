@@ -0,0 +1,74 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2020  Black Sphere Technologies Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Double buffered flash loader for Cortex-M targets.
+ *
+ * The stub, a mailbox and two data buffers of buf_size bytes are placed at
+ * the start of target RAM. The stub is started once and keeps running
+ * while the host fills one buffer and the stub programs the other.
+ *
+ * The stub is entered with r0 pointing to the mailbox and r1-r3 holding
+ * the driver arguments. The mailbox holds two slots of {len, dest, src}
+ * followed by a stop flag and a status word. The host hands a buffer to
+ * the stub by writing dest and then a non-zero len. The stub programs len
+ * bytes from src to dest and clears len to hand the buffer back. It then
+ * moves on to the other slot. If the slot is empty and stop is set, the
+ * stub exits with BKPT 0. On an error it stores a driver specific code in
+ * status and exits with a non-zero BKPT.
+ */
+#ifndef __FLASHLOADER_H
+#define __FLASHLOADER_H
+
+#include "target.h"
+#include "target_internal.h"
+
+#define FLASHLOADER_SLOT(n)		((n) * 0x0c)
+#define FLASHLOADER_SLOT_LEN		0x00
+#define FLASHLOADER_SLOT_DEST		0x04
+#define FLASHLOADER_SLOT_SRC		0x08
+#define FLASHLOADER_STOP		0x18
+#define FLASHLOADER_STATUS		0x1c
+#define FLASHLOADER_MAILBOX_SIZE	0x20
+
+struct flashloader {
+	const uint16_t *stub;
+	size_t stub_size;
+};
+
+/* Drivers allocate this in place of a struct target_flash and fill in f
+ * as usual. f.write must remain a working word by word implementation,
+ * it is used whenever the loader can not be started. */
+struct flashloader_flash {
+	struct target_flash f;
+	const struct flashloader *loader;
+	uint32_t args[3];
+
+	/* Set up by flashloader_add_flash() */
+	flash_erase_func erase;
+	flash_write_func write;
+	flash_done_func done;
+	bool running;
+	unsigned slot;
+	target_addr mailbox;
+	target_addr buf[2];
+};
+
+void flashloader_add_flash(target *t, struct flashloader_flash *lf);
+
+#endif
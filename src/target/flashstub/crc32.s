@@ -0,0 +1,57 @@
+@ This file is part of the Black Magic Debug project.
+@
+@ This program is free software: you can redistribute it and/or modify
+@ it under the terms of the GNU General Public License as published by
+@ the Free Software Foundation, either version 3 of the License, or
+@ (at your option) any later version.
+@
+@ This program is distributed in the hope that it will be useful,
+@ but WITHOUT ANY WARRANTY; without even the implied warranty of
+@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+@ GNU General Public License for more details.
+@
+@ You should have received a copy of the GNU General Public License
+@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@ CRC32 as computed by generic_crc32(), a nibble at a time.
+@ Called with r0 = initial crc, r1 = address, r2 = length.
+@ Returns the crc in r0.
+
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+
+	.global	crc32_stub
+crc32_stub:
+	adr	r3, table
+	cmp	r2, #0
+	beq	done
+loop:
+	ldrb	r4, [r1]
+	adds	r1, #1
+	lsrs	r5, r0, #28		@ High nibble
+	lsrs	r6, r4, #4
+	eors	r5, r6
+	lsls	r5, r5, #2
+	ldr	r5, [r3, r5]
+	lsls	r0, r0, #4
+	eors	r0, r5
+	lsrs	r5, r0, #28		@ Low nibble
+	lsls	r4, r4, #28
+	lsrs	r4, r4, #28
+	eors	r5, r4
+	lsls	r5, r5, #2
+	ldr	r5, [r3, r5]
+	lsls	r0, r0, #4
+	eors	r0, r5
+	subs	r2, #1
+	bne	loop
+done:
+	bkpt	#0
+
+	.align	2
+table:
+	.word	0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9
+	.word	0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005
+	.word	0x2608edb8, 0x22c9f00f, 0x2f8ad6d6, 0x2b4bcb61
+	.word	0x350c9b64, 0x31cd86d3, 0x3c8ea00a, 0x384fbdbd
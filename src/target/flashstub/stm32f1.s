@@ -0,0 +1,76 @@
+@ This file is part of the Black Magic Debug project.
+@
+@ This program is free software: you can redistribute it and/or modify
+@ it under the terms of the GNU General Public License as published by
+@ the Free Software Foundation, either version 3 of the License, or
+@ (at your option) any later version.
+@
+@ This program is distributed in the hope that it will be useful,
+@ but WITHOUT ANY WARRANTY; without even the implied warranty of
+@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+@ GNU General Public License for more details.
+@
+@ You should have received a copy of the GNU General Public License
+@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@ Double buffered STM32F0/F1/F3 flash loader, see flashloader.h.
+@ Called with r0 = mailbox, r1 = flash controller base.
+@ Only Thumb-1 instructions are used so that Cortex-M0 parts work too.
+
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+
+	.equ	MBOX_STOP,	0x18
+	.equ	MBOX_STATUS,	0x1c
+	.equ	SLOT_LEN,	0x00
+	.equ	SLOT_DEST,	0x04
+	.equ	SLOT_SRC,	0x08
+	.equ	SLOT_SIZE,	0x0c
+
+	.equ	FLASH_SR,	0x0c
+	.equ	FLASH_CR,	0x10
+	.equ	FLASH_CR_PG,	0x01
+
+	.global	stm32f1_flash_loader
+stm32f1_flash_loader:
+	movs	r4, #0			@ Offset of the current slot
+wait:
+	adds	r5, r0, r4
+	ldr	r2, [r5, #SLOT_LEN]
+	cmp	r2, #0
+	bne	program
+	ldr	r3, [r0, #MBOX_STOP]
+	cmp	r3, #0
+	beq	wait
+	bkpt	#0
+
+program:
+	ldr	r3, [r5, #SLOT_DEST]
+	ldr	r6, [r5, #SLOT_SRC]
+	movs	r7, #FLASH_CR_PG
+	str	r7, [r1, #FLASH_CR]
+copy:
+	ldrh	r7, [r6]
+	strh	r7, [r3]
+busy:
+	ldr	r7, [r1, #FLASH_SR]
+	lsrs	r7, r7, #1		@ BSY into carry
+	bcs	busy
+	ldr	r7, [r1, #FLASH_SR]
+	lsls	r7, r7, #27		@ Only PGERR and WRPRTERR remain
+	bne	error
+	adds	r3, #2
+	adds	r6, #2
+	subs	r2, #2
+	bhi	copy
+	movs	r7, #0
+	str	r7, [r5, #SLOT_LEN]	@ Hand the buffer back
+	movs	r7, #SLOT_SIZE
+	eors	r4, r7
+	b	wait
+
+error:
+	ldr	r7, [r1, #FLASH_SR]
+	str	r7, [r0, #MBOX_STATUS]
+	bkpt	#1
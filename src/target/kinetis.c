@@ -56,6 +56,9 @@
 #define FTFA_FSTAT_FPVIOL   (1 << 4)
 #define FTFA_FSTAT_MGSTAT0  (1 << 0)
 
+/* Upper bound for a single FTFA command */
+#define FTFA_CMD_TIMEOUT_MS 5000
+
 #define FTFA_CMD_CHECK_ERASE       0x01
 #define FTFA_CMD_PROGRAM_CHECK     0x02
 #define FTFA_CMD_READ_RESOURCE     0x03
@@ -272,15 +275,15 @@ bool kinetis_probe(target *t)
 static bool
 kl_gen_command(target *t, uint8_t cmd, uint32_t addr, const uint8_t data[8])
 {
-	uint8_t fstat;
+	uint32_t fstat;
 
 	/* clear errors unconditionally, so we can start a new operation */
 	target_mem_write8(t,FTFA_FSTAT,(FTFA_FSTAT_ACCERR | FTFA_FSTAT_FPVIOL));
 
-	/* Wait for CCIF to be high */
-	do {
-		fstat = target_mem_read8(t, FTFA_FSTAT);
-	} while (!(fstat & FTFA_FSTAT_CCIF));
+	/* Wait for CCIF to be high. FSTAT is the lowest byte of the word. */
+	if (target_mem_poll32(t, FTFA_FSTAT, FTFA_FSTAT_CCIF, FTFA_FSTAT_CCIF,
+	                      FTFA_CMD_TIMEOUT_MS, NULL))
+		return false;
 
 	/* Write command to FCCOB */
 	addr &= 0xffffff;
@@ -294,13 +297,14 @@ kl_gen_command(target *t, uint8_t cmd, uint32_t addr, const uint8_t data[8])
 	/* Enable execution by clearing CCIF */
 	target_mem_write8(t, FTFA_FSTAT, FTFA_FSTAT_CCIF);
 
-	/* Wait for execution to complete */
-	do {
-		fstat = target_mem_read8(t, FTFA_FSTAT);
-		/* Check ACCERR and FPVIOL are zero in FSTAT */
-		if (fstat & (FTFA_FSTAT_ACCERR | FTFA_FSTAT_FPVIOL))
-			return false;
-	} while (!(fstat & FTFA_FSTAT_CCIF));
+	/* Wait for execution to complete. A command rejected with ACCERR or
+	 * FPVIOL is not launched and leaves CCIF set. */
+	if (target_mem_poll32(t, FTFA_FSTAT, FTFA_FSTAT_CCIF, FTFA_FSTAT_CCIF,
+	                      FTFA_CMD_TIMEOUT_MS, &fstat))
+		return false;
+	/* Check ACCERR and FPVIOL are zero in FSTAT */
+	if (fstat & (FTFA_FSTAT_ACCERR | FTFA_FSTAT_FPVIOL))
+		return false;
 
 	return true;
 }
@@ -66,6 +66,9 @@ const struct command_s nrf51_read_cmd_list[] = {
 #define NRF51_NVMC_CONFIG_WEN		0x1						// Write enable
 #define NRF51_NVMC_CONFIG_EEN		0x2						// Erase enable
 
+/* Page erase takes up to ~90 ms, erase all up to ~300 ms */
+#define NRF51_NVMC_TIMEOUT_MS		1000
+
 /* Factory Information Configuration Registers (FICR) */
 #define NRF51_FICR				0x10000000
 #define NRF51_FICR_CODEPAGESIZE			(NRF51_FICR + 0x010)
@@ -114,16 +117,24 @@ static void nrf51_add_flash(target *t,
 
 bool nrf51_probe(target *t)
 {
-	uint32_t page_size = target_mem_read32(t, NRF51_FICR_CODEPAGESIZE);
-	uint32_t code_size = target_mem_read32(t, NRF51_FICR_CODESIZE);
+	struct target_mem32 ficr[] = {
+		{NRF51_FICR_CODEPAGESIZE, 0},
+		{NRF51_FICR_CODESIZE, 0},
+		{NRF51_FICR_DEVICEID_LOW, 0},
+		{NRF51_FICR_DEVICEID_HIGH, 0},
+	};
+	if (target_mem_read32_batch(t, ficr, ARRAY_NUMELEM(ficr)))
+		return false;
+	uint32_t page_size = ficr[0].value;
+	uint32_t code_size = ficr[1].value;
 	/* Check that page_size and code_size makes sense */
 	if ((page_size == 0xffffffff) || (code_size == 0xffffffff) ||
 		(page_size ==  0) || (code_size ==  0) ||
 		(page_size > 0x10000) || (code_size > 0x10000))
 		return false;
 	/* Check that device identifier makes sense */
-	uint32_t uid0 = target_mem_read32(t, NRF51_FICR_DEVICEID_LOW);
-	uint32_t uid1 = target_mem_read32(t, NRF51_FICR_DEVICEID_HIGH);
+	uint32_t uid0 = ficr[2].value;
+	uint32_t uid1 = ficr[3].value;
 	if ((uid0 == 0xffffffff) || (uid1 == 0xffffffff) ||
 		(uid0 ==  0) || (uid1 ==  0))
 		return false;
@@ -160,9 +171,9 @@ static int nrf51_flash_erase(struct target_flash *f, target_addr addr, size_t le
 	target_mem_write32(t, NRF51_NVMC_CONFIG, NRF51_NVMC_CONFIG_EEN);
 
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0)
-		if(target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, NRF51_NVMC_READY, 1, 1,
+	                      NRF51_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 
 	while (len) {
 		if (addr == NRF51_UICR) { // Special Case
@@ -175,9 +186,9 @@ static int nrf51_flash_erase(struct target_flash *f, target_addr addr, size_t le
 		}
 
 		/* Poll for NVMC_READY */
-		while (target_mem_read32(t, NRF51_NVMC_READY) == 0)
-			if(target_check_error(t))
-				return -1;
+		if (target_mem_poll32(t, NRF51_NVMC_READY, 1, 1,
+		                      NRF51_NVMC_TIMEOUT_MS, NULL))
+			return -1;
 
 		addr += f->blocksize;
 		if (len > f->blocksize)
@@ -190,9 +201,9 @@ static int nrf51_flash_erase(struct target_flash *f, target_addr addr, size_t le
 	target_mem_write32(t, NRF51_NVMC_CONFIG, NRF51_NVMC_CONFIG_REN);
 
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0)
-		if(target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, NRF51_NVMC_READY, 1, 1,
+	                      NRF51_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 
 	return 0;
 }
@@ -205,14 +216,14 @@ static int nrf51_flash_write(struct target_flash *f,
 	/* Enable write */
 	target_mem_write32(t, NRF51_NVMC_CONFIG, NRF51_NVMC_CONFIG_WEN);
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0)
-		if(target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, NRF51_NVMC_READY, 1, 1,
+	                      NRF51_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 	target_mem_write(t, dest, src, len);
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0)
-		if(target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, NRF51_NVMC_READY, 1, 1,
+	                      NRF51_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 	/* Return to read-only */
 	target_mem_write32(t, NRF51_NVMC_CONFIG, NRF51_NVMC_CONFIG_REN);
 	return 0;
@@ -228,17 +239,17 @@ static bool nrf51_cmd_erase_all(target *t, int argc, const char **argv)
 	target_mem_write32(t, NRF51_NVMC_CONFIG, NRF51_NVMC_CONFIG_EEN);
 
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0)
-		if(target_check_error(t))
-			return false;
+	if (target_mem_poll32(t, NRF51_NVMC_READY, 1, 1,
+	                      NRF51_NVMC_TIMEOUT_MS, NULL))
+		return false;
 
 	/* Erase all */
 	target_mem_write32(t, NRF51_NVMC_ERASEALL, 1);
 
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0)
-		if(target_check_error(t))
-			return false;
+	if (target_mem_poll32(t, NRF51_NVMC_READY, 1, 1,
+	                      NRF51_NVMC_TIMEOUT_MS, NULL))
+		return false;
 
 	return true;
 }
@@ -74,6 +74,9 @@ const struct command_s sam3x_cmd_list[] = {
 #define EEFC_FSR_FLOCKE		(1 << 2)
 #define EEFC_FSR_ERROR		(EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE)
 
+/* Upper bound for a single EEFC command, erase all included */
+#define EEFC_TIMEOUT_MS		10000
+
 #define SAM3X_CHIPID_CIDR	0x400E0940
 #define SAM34NSU_CHIPID_CIDR	0x400E0740
 
@@ -269,11 +272,11 @@ sam3x_flash_cmd(target *t, uint32_t base, uint8_t cmd, uint16_t arg)
 	target_mem_write32(t, EEFC_FCR(base),
 	                   EEFC_FCR_FKEY | cmd | ((uint32_t)arg << 8));
 
-	while (!(target_mem_read32(t, EEFC_FSR(base)) & EEFC_FSR_FRDY))
-		if(target_check_error(t))
-			return -1;
-
-	uint32_t sr = target_mem_read32(t, EEFC_FSR(base));
+	/* Error flags may be cleared on read, so use the value with FRDY set */
+	uint32_t sr;
+	if (target_mem_poll32(t, EEFC_FSR(base), EEFC_FSR_FRDY, EEFC_FSR_FRDY,
+	                      EEFC_TIMEOUT_MS, &sr))
+		return -1;
 	return sr & EEFC_FSR_ERROR;
 }
 
@@ -160,7 +160,7 @@ static const size_t __nvp_size[16] = {
 
 
 /* Arbitrary time to wait for FLASH controller to be ready */
-#define FLASH_TIMEOUT	10000
+#define FLASH_TIMEOUT_MS	2000
 
 /*
  * Populate a target_flash struct with the necessary function pointers
@@ -297,17 +297,11 @@ sam4l_flash_command(target *t, uint32_t page, uint32_t cmd)
 {
 	uint32_t cmd_reg;
 	uint32_t status;
-	int	timeout;
 	DEBUG("\nSAM4L: sam4l_flash_command: FSR: 0x%08x, page = %d, command = %d\n",
 		(unsigned int)(FLASHCALW_FSR), (int) page, (int) cmd);
 	/* wait for Flash controller ready */
-	for (timeout = 0; timeout < FLASH_TIMEOUT; timeout++) {
-		status = target_mem_read32(t, FLASHCALW_FSR);
-		if (status & FLASHCALW_FSR_FRDY) {
-			break;
-		}
-	}
-	if (timeout == FLASH_TIMEOUT) {
+	if (target_mem_poll32(t, FLASHCALW_FSR, FLASHCALW_FSR_FRDY,
+	                      FLASHCALW_FSR_FRDY, FLASH_TIMEOUT_MS, &status)) {
 		DEBUG("\nSAM4L: sam4l_flash_command: Not ready! Status = 0x%08x\n", (unsigned int) status);
 		return -1; /* Failed */
 	}
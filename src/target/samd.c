@@ -96,6 +96,9 @@ const struct command_s samd_cmd_list[] = {
 /* Interrupt Flag Register (INTFLAG) */
 #define SAMD_NVMC_READY			(1 << 0)
 
+/* Longest NVM operation is a row erase, allow for plenty of margin */
+#define SAMD_NVMC_TIMEOUT_MS		1000
+
 /* Non-Volatile Memory Calibration and Auxiliary Registers */
 #define SAMD_NVM_USER_ROW_LOW		0x00804000
 #define SAMD_NVM_USER_ROW_HIGH		0x00804004
@@ -590,9 +593,9 @@ static int samd_flash_erase(struct target_flash *f, target_addr addr, size_t len
 		target_mem_write32(t, SAMD_NVMC_CTRLA,
 		                   SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_ERASEROW);
 		/* Poll for NVM Ready */
-		while ((target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_READY) == 0)
-			if (target_check_error(t))
-				return -1;
+		if (target_mem_poll32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY,
+		                      SAMD_NVMC_READY, SAMD_NVMC_TIMEOUT_MS, NULL))
+			return -1;
 
 		/* Lock */
 		samd_lock_current_address(t);
@@ -626,9 +629,9 @@ static int samd_flash_write(struct target_flash *f,
 	                   SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_WRITEPAGE);
 
 	/* Poll for NVM Ready */
-	while ((target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_READY) == 0)
-		if (target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY,
+	                      SAMD_NVMC_READY, SAMD_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 
 	/* Lock */
 	samd_lock_current_address(t);
@@ -697,9 +700,9 @@ static bool samd_set_flashlock(target *t, uint16_t value, const char **argv)
 	                   SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_ERASEAUXROW);
 
 	/* Poll for NVM Ready */
-	while ((target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_READY) == 0)
-		if (target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY,
+	                      SAMD_NVMC_READY, SAMD_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 
 	/* Modify the high byte of the user row */
 	high = (high & 0x0000FFFF) | ((value << 16) & 0xFFFF0000);
@@ -744,9 +747,9 @@ static bool samd_set_bootprot(target *t, uint16_t value, const char **argv)
 	                   SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_ERASEAUXROW);
 
 	/* Poll for NVM Ready */
-	while ((target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_READY) == 0)
-		if (target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY,
+	                      SAMD_NVMC_READY, SAMD_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 
 	/* Modify the low word of the user row */
 	low = (low & 0xFFFFFFF8) | ((value << 0 ) & 0x00000007);
@@ -872,9 +875,9 @@ static bool samd_cmd_ssb(target *t, int argc, const char **argv)
 	                   SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_SSB);
 
 	/* Poll for NVM Ready */
-	while ((target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_READY) == 0)
-		if (target_check_error(t))
-			return -1;
+	if (target_mem_poll32(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY,
+	                      SAMD_NVMC_READY, SAMD_NVMC_TIMEOUT_MS, NULL))
+		return -1;
 
 	tc_printf(t, "Set the security bit! "
 		  "You will need to issue 'monitor erase_mass' to clear this.\n");
@@ -38,6 +38,7 @@
 #include "target.h"
 #include "target_internal.h"
 #include "cortexm.h"
+#include "flashloader.h"
 
 static bool stm32f1_cmd_erase_mass(target *t, int argc, const char **argv);
 static bool stm32f1_cmd_option(target *t, int argc, const char **argv);
@@ -88,21 +89,34 @@ static int stm32f1_flash_write(struct target_flash *f,
 #define SR_ERROR_MASK	0x14
 #define SR_EOP		0x20
 
+/* Upper bound for any single flash operation */
+#define FLASH_BSY_TIMEOUT_MS	5000
+
 #define DBGMCU_IDCODE	0xE0042000
 #define DBGMCU_IDCODE_F0	0x40015800
 
 #define FLASHSIZE     0x1FFFF7E0
 #define FLASHSIZE_F0  0x1FFFF7CC
 
+static const uint16_t stm32f1_flash_loader_stub[] = {
+#include "flashstub/stm32f1.stub"
+};
+
+static const struct flashloader stm32f1_flash_loader = {
+	.stub = stm32f1_flash_loader_stub,
+	.stub_size = sizeof(stm32f1_flash_loader_stub),
+};
+
 static void stm32f1_add_flash(target *t,
                               uint32_t addr, size_t length, size_t erasesize)
 {
-	struct target_flash *f = calloc(1, sizeof(*f));
-	if (!f) {			/* calloc failed: heap exhaustion */
+	struct flashloader_flash *lf = calloc(1, sizeof(*lf));
+	if (!lf) {			/* calloc failed: heap exhaustion */
 		DEBUG("calloc: failed in %s\n", __func__);
 		return;
 	}
 
+	struct target_flash *f = &lf->f;
 	f->start = addr;
 	f->length = length;
 	f->blocksize = erasesize;
@@ -110,7 +124,9 @@ static void stm32f1_add_flash(target *t,
 	f->write = stm32f1_flash_write;
 	f->buf_size = erasesize;
 	f->erased = 0xff;
-	target_add_flash(t, f);
+	lf->loader = &stm32f1_flash_loader;
+	lf->args[0] = FPEC_BASE;
+	flashloader_add_flash(t, lf);
 }
 
 bool stm32f1_probe(target *t)
@@ -185,8 +201,11 @@ bool stm32f1_probe(target *t)
 
 static void stm32f1_flash_unlock(target *t)
 {
-	target_mem_write32(t, FLASH_KEYR, KEY1);
-	target_mem_write32(t, FLASH_KEYR, KEY2);
+	const struct target_mem32 unlock[] = {
+		{FLASH_KEYR, KEY1},
+		{FLASH_KEYR, KEY2},
+	};
+	target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
 }
 
 static int stm32f1_flash_erase(struct target_flash *f,
@@ -197,19 +216,25 @@ static int stm32f1_flash_erase(struct target_flash *f,
 	stm32f1_flash_unlock(t);
 
 	while(len) {
-		/* Flash page erase instruction */
-		target_mem_write32(t, FLASH_CR, FLASH_CR_PER);
-		/* write address to FMA */
-		target_mem_write32(t, FLASH_AR, addr);
-		/* Flash page erase start instruction */
-		target_mem_write32(t, FLASH_CR, FLASH_CR_STRT | FLASH_CR_PER);
+		const struct target_mem32 erase[] = {
+			/* Flash page erase instruction */
+			{FLASH_CR, FLASH_CR_PER},
+			/* write address to FMA */
+			{FLASH_AR, addr},
+			/* Flash page erase start instruction */
+			{FLASH_CR, FLASH_CR_STRT | FLASH_CR_PER},
+		};
+		if (target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase))) {
+			DEBUG("stm32f1 flash erase: comm error\n");
+			return -1;
+		}
 
 		/* Read FLASH_SR to poll for BSY bit */
-		while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-			if(target_check_error(t)) {
-				DEBUG("stm32f1 flash erase: comm error\n");
-				return -1;
-			}
+		if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+		                      FLASH_BSY_TIMEOUT_MS, NULL)) {
+			DEBUG("stm32f1 flash erase: comm error\n");
+			return -1;
+		}
 		if (len > f->blocksize)
 			len -= f->blocksize;
 		else
@@ -236,13 +261,11 @@ static int stm32f1_flash_write(struct target_flash *f,
 	cortexm_mem_write_sized(t, dest, src, len, ALIGN_HALFWORD);
 	/* Read FLASH_SR to poll for BSY bit */
 	/* Wait for completion or an error */
-	do {
-		sr = target_mem_read32(t, FLASH_SR);
-		if(target_check_error(t)) {
-			DEBUG("stm32f1 flash write: comm error\n");
-			return -1;
-		}
-	} while (sr & FLASH_SR_BSY);
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr)) {
+		DEBUG("stm32f1 flash write: comm error\n");
+		return -1;
+	}
 
 	if (sr & SR_ERROR_MASK) {
 		DEBUG("stm32f1 flash write error 0x%" PRIx32 "\n", sr);
@@ -258,16 +281,19 @@ static bool stm32f1_cmd_erase_mass(target *t, int argc, const char **argv)
 	stm32f1_flash_unlock(t);
 
 	/* Flash mass erase start instruction */
-	target_mem_write32(t, FLASH_CR, FLASH_CR_MER);
-	target_mem_write32(t, FLASH_CR, FLASH_CR_STRT | FLASH_CR_MER);
+	const struct target_mem32 erase[] = {
+		{FLASH_CR, FLASH_CR_MER},
+		{FLASH_CR, FLASH_CR_STRT | FLASH_CR_MER},
+	};
+	target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase));
 
 	/* Read FLASH_SR to poll for BSY bit */
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return false;
+	uint32_t sr;
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr))
+		return false;
 
 	/* Check for error */
-	uint16_t sr = target_mem_read32(t, FLASH_SR);
 	if ((sr & SR_ERROR_MASK) || !(sr & SR_EOP))
 		return false;
 
@@ -277,14 +303,14 @@ static bool stm32f1_cmd_erase_mass(target *t, int argc, const char **argv)
 static bool stm32f1_option_erase(target *t)
 {
 	/* Erase option bytes instruction */
-	target_mem_write32(t, FLASH_CR, FLASH_CR_OPTER | FLASH_CR_OPTWRE);
-	target_mem_write32(t, FLASH_CR,
-			   FLASH_CR_STRT | FLASH_CR_OPTER | FLASH_CR_OPTWRE);
+	const struct target_mem32 erase[] = {
+		{FLASH_CR, FLASH_CR_OPTER | FLASH_CR_OPTWRE},
+		{FLASH_CR, FLASH_CR_STRT | FLASH_CR_OPTER | FLASH_CR_OPTWRE},
+	};
+	target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase));
 	/* Read FLASH_SR to poll for BSY bit */
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return false;
-	return true;
+	return !target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                          FLASH_BSY_TIMEOUT_MS, NULL);
 }
 
 static bool stm32f1_option_write_erased(target *t, uint32_t addr, uint16_t value)
@@ -295,10 +321,8 @@ static bool stm32f1_option_write_erased(target *t, uint32_t addr, uint16_t value
 	target_mem_write32(t, FLASH_CR, FLASH_CR_OPTPG | FLASH_CR_OPTWRE);
 	target_mem_write16(t, addr, value);
 	/* Read FLASH_SR to poll for BSY bit */
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return false;
-	return true;
+	return !target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                          FLASH_BSY_TIMEOUT_MS, NULL);
 }
 
 static bool stm32f1_option_write(target *t, uint32_t addr, uint16_t value)
@@ -350,9 +374,13 @@ static bool stm32f1_cmd_option(target *t, int argc, const char **argv)
 	default: flash_obp_rdp_key = FLASH_OBP_RDP_KEY;
 	}
 	rdprt = target_mem_read32(t, FLASH_OBR) & FLASH_OBR_RDPRT;
-	stm32f1_flash_unlock(t);
-	target_mem_write32(t, FLASH_OPTKEYR, KEY1);
-	target_mem_write32(t, FLASH_OPTKEYR, KEY2);
+	const struct target_mem32 unlock[] = {
+		{FLASH_KEYR, KEY1},
+		{FLASH_KEYR, KEY2},
+		{FLASH_OPTKEYR, KEY1},
+		{FLASH_OPTKEYR, KEY2},
+	};
+	target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
 
 	if ((argc == 2) && !strcmp(argv[1], "erase")) {
 		stm32f1_option_erase(t);
@@ -95,6 +95,9 @@ static int stm32f4_flash_write(struct target_flash *f,
 #define SR_ERROR_MASK	0xF2
 #define SR_EOP		0x01
 
+/* Upper bound for a sector erase or a program operation */
+#define FLASH_BSY_TIMEOUT_MS	10000
+
 #define F4_FLASHSIZE	0x1FFF7A22
 #define F7_FLASHSIZE	0x1FF0F442
 #define F72X_FLASHSIZE	0x1FF07A22
@@ -376,8 +379,11 @@ static void stm32f4_flash_unlock(target *t)
 {
 	if (target_mem_read32(t, FLASH_CR) & FLASH_CR_LOCK) {
 		/* Enable FPEC controller access */
-		target_mem_write32(t, FLASH_KEYR, KEY1);
-		target_mem_write32(t, FLASH_KEYR, KEY2);
+		const struct target_mem32 unlock[] = {
+			{FLASH_KEYR, KEY1},
+			{FLASH_KEYR, KEY2},
+		};
+		target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
 	}
 }
 
@@ -400,17 +406,23 @@ static int stm32f4_flash_erase(struct target_flash *f, target_addr addr,
 	while(len) {
 		uint32_t cr = FLASH_CR_EOPIE | FLASH_CR_ERRIE | FLASH_CR_SER |
 			(psize * FLASH_CR_PSIZE16) | (sector << 3);
-		/* Flash page erase instruction */
-		target_mem_write32(t, FLASH_CR, cr);
-		/* write address to FMA */
-		target_mem_write32(t, FLASH_CR, cr | FLASH_CR_STRT);
+		const struct target_mem32 erase[] = {
+			/* Flash page erase instruction */
+			{FLASH_CR, cr},
+			/* Flash page erase start instruction */
+			{FLASH_CR, cr | FLASH_CR_STRT},
+		};
+		if (target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase))) {
+			DEBUG("stm32f4 flash erase: comm error\n");
+			return -1;
+		}
 
 		/* Read FLASH_SR to poll for BSY bit */
-		while(target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-			if(target_check_error(t)) {
-				DEBUG("stm32f4 flash erase: comm error\n");
-				return -1;
-			}
+		if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+		                      FLASH_BSY_TIMEOUT_MS, NULL)) {
+			DEBUG("stm32f4 flash erase: comm error\n");
+			return -1;
+		}
 		if (len > f->blocksize)
 			len -= f->blocksize;
 		else
@@ -444,13 +456,11 @@ static int stm32f4_flash_write(struct target_flash *f,
 	cortexm_mem_write_sized(t, dest, src, len, psize);
 	/* Read FLASH_SR to poll for BSY bit */
 	/* Wait for completion or an error */
-	do {
-		sr = target_mem_read32(t, FLASH_SR);
-		if(target_check_error(t)) {
-			DEBUG("stm32f4 flash write: comm error\n");
-			return -1;
-		}
-	} while (sr & FLASH_SR_BSY);
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr)) {
+		DEBUG("stm32f4 flash write: comm error\n");
+		return -1;
+	}
 
 	if (sr & SR_ERROR_MASK) {
 		DEBUG("stm32f4 flash write error 0x%" PRIx32 "\n", sr);
@@ -475,21 +485,23 @@ static bool stm32f4_cmd_erase_mass(target *t, int argc, const char **argv)
 	uint32_t cr =  FLASH_CR_MER;
 	if (sf->bank_split)
 		cr |=  FLASH_CR_MER1;
-	target_mem_write32(t, FLASH_CR, cr);
-	target_mem_write32(t, FLASH_CR, cr | FLASH_CR_STRT);
+	const struct target_mem32 erase[] = {
+		{FLASH_CR, cr},
+		{FLASH_CR, cr | FLASH_CR_STRT},
+	};
+	target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase));
 
-	/* Read FLASH_SR to poll for BSY bit */
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY) {
+	/* Read FLASH_SR to poll for BSY bit, spin while waiting */
+	uint32_t sr;
+	int res;
+	while ((res = target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0, 500,
+	                                &sr)) > 0)
 		tc_printf(t, "\b%c", spinner[spinindex++ % 4]);
-		if(target_check_error(t)) {
-			tc_printf(t, "\n");
-			return false;
-		}
-	}
 	tc_printf(t, "\n");
+	if (res < 0)
+		return false;
 
 	/* Check for error */
-	uint32_t sr = target_mem_read32(t, FLASH_SR);
 	if ((sr & SR_ERROR_MASK) || !(sr & SR_EOP))
 		return false;
 
@@ -563,11 +575,14 @@ bool optcr_mask(target *t, uint32_t *val)
 
 static bool stm32f4_option_write(target *t, uint32_t *val, int count)
 {
-	target_mem_write32(t, FLASH_OPTKEYR, OPTKEY1);
-	target_mem_write32(t, FLASH_OPTKEYR, OPTKEY2);
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return -1;
+	const struct target_mem32 unlock[] = {
+		{FLASH_OPTKEYR, OPTKEY1},
+		{FLASH_OPTKEYR, OPTKEY2},
+	};
+	target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, NULL))
+		return -1;
 
 	/* WRITE option bytes instruction */
 	if (((t->idcode == ID_STM32F42X) || (t->idcode == ID_STM32F46X) ||
@@ -578,12 +593,15 @@ static bool stm32f4_option_write(target *t, uint32_t *val, int count)
 	if ((t->idcode == ID_STM32F72X) && (count > 2))
 			target_mem_write32(t, FLASH_OPTCR + 8, val[2]);
 
-	target_mem_write32(t, FLASH_OPTCR, val[0]);
-	target_mem_write32(t, FLASH_OPTCR, val[0] | FLASH_OPTCR_OPTSTRT);
+	const struct target_mem32 start[] = {
+		{FLASH_OPTCR, val[0]},
+		{FLASH_OPTCR, val[0] | FLASH_OPTCR_OPTSTRT},
+	};
+	target_mem_write32_batch(t, start, ARRAY_NUMELEM(start));
 	/* Read FLASH_SR to poll for BSY bit */
-	while(target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return false;
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, NULL))
+		return false;
 	target_mem_write32(t, FLASH_OPTCR, FLASH_OPTCR_OPTLOCK);
 	return true;
 }
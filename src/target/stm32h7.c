@@ -125,6 +125,9 @@ enum stm32h7_regs
 #define KEY1 0x45670123
 #define KEY2 0xCDEF89AB
 
+/* Upper bound for a sector erase or a program operation */
+#define FLASH_BSY_TIMEOUT_MS	10000
+
 #define OPTKEY1 0x08192A3B
 #define OPTKEY2 0x4C5D6E7F
 
@@ -252,11 +255,10 @@ static bool stm32h7_flash_unlock(target *t, uint32_t addr)
 		regbase = FPEC2_BASE;
 	}
 
-	while(target_mem_read32(t, regbase + FLASH_SR) & FLASH_SR_BSY) {
-		if(target_check_error(t))
-			return false;
-	}
-	uint32_t sr = target_mem_read32(t, regbase + FLASH_SR);
+	uint32_t sr;
+	if (target_mem_poll32(t, regbase + FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr))
+		return false;
 	if (sr & FLASH_SR_ERROR_MASK) {
 		tc_printf(t, "Error 0x%08lx", sr & FLASH_SR_ERROR_MASK);
 		target_mem_write32(t, regbase + FLASH_CCR, sr & FLASH_SR_ERROR_MASK);
@@ -264,8 +266,11 @@ static bool stm32h7_flash_unlock(target *t, uint32_t addr)
 	}
 	if (target_mem_read32(t, regbase + FLASH_CR) & FLASH_CR_LOCK) {
 		/* Enable FLASH controller access */
-		target_mem_write32(t, regbase + FLASH_KEYR, KEY1);
-		target_mem_write32(t, regbase + FLASH_KEYR, KEY2);
+		const struct target_mem32 unlock[] = {
+			{regbase + FLASH_KEYR, KEY1},
+			{regbase + FLASH_KEYR, KEY2},
+		};
+		target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
 	}
 	if (target_mem_read32(t, regbase + FLASH_CR) & FLASH_CR_LOCK)
 		return false;
@@ -291,20 +296,23 @@ static int stm32h7_flash_erase(struct target_flash *f, target_addr addr,
 	while (start_sector <= end_sector) {
 		uint32_t cr = (psize * FLASH_CR_PSIZE16) | FLASH_CR_SER |
 			(start_sector * FLASH_CR_SNB_1);
-		target_mem_write32(t, sf->regbase + FLASH_CR, cr);
-		cr |= FLASH_CR_START;
-		target_mem_write32(t, sf->regbase + FLASH_CR, cr);
+		const struct target_mem32 erase[] = {
+			{sf->regbase + FLASH_CR, cr},
+			{sf->regbase + FLASH_CR, cr | FLASH_CR_START},
+		};
+		if (target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase))) {
+			DEBUG("stm32h7_flash_erase: comm failed\n");
+			return -1;
+		}
 		DEBUG(" started cr %08" PRIx32 " sr %08" PRIx32 "\n",
 			  target_mem_read32(t, sf->regbase + FLASH_CR),
 			  target_mem_read32(t, sf->regbase + FLASH_SR));
-		do {
-			sr = target_mem_read32(t, sf->regbase + FLASH_SR);
-			if (target_check_error(t)) {
-				DEBUG("stm32h7_flash_erase: comm failed\n");
-				return -1;
-			}
-//			target_mem_write32(t, H7_IWDG_BASE, 0x0000aaaa);
-		}while (sr & (FLASH_SR_QW | FLASH_SR_BSY));
+		if (target_mem_poll32(t, sf->regbase + FLASH_SR,
+		                      FLASH_SR_QW | FLASH_SR_BSY, 0,
+		                      FLASH_BSY_TIMEOUT_MS, &sr)) {
+			DEBUG("stm32h7_flash_erase: comm failed\n");
+			return -1;
+		}
 		if (sr & FLASH_SR_ERROR_MASK) {
 			DEBUG("stm32h7_flash_erase: error, sr: %08" PRIx32 "\n", sr);
 			return -1;
@@ -323,18 +331,19 @@ static int stm32h7_flash_write(struct target_flash *f, target_addr dest,
 	if (stm32h7_flash_unlock(t, dest) == false)
 		return -1;
 	uint32_t cr = psize * FLASH_CR_PSIZE16;
-	target_mem_write32(t, sf->regbase + FLASH_CR, cr);
-	cr |= FLASH_CR_PG;
-	target_mem_write32(t, sf->regbase + FLASH_CR, cr);
+	const struct target_mem32 program[] = {
+		{sf->regbase + FLASH_CR, cr},
+		{sf->regbase + FLASH_CR, cr | FLASH_CR_PG},
+	};
+	target_mem_write32_batch(t, program, ARRAY_NUMELEM(program));
 	/* does H7 stall?*/
 	uint32_t sr_reg = sf->regbase + FLASH_SR;
 	uint32_t sr;
 	target_mem_write(t, dest, src, len);
-	while ((sr = target_mem_read32(t, sr_reg)) & FLASH_SR_BSY) {
-		if(target_check_error(t)) {
-			DEBUG("stm32h7_flash_write: BSY comm failed\n");
-			return -1;
-		}
+	if (target_mem_poll32(t, sr_reg, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr)) {
+		DEBUG("stm32h7_flash_write: BSY comm failed\n");
+		return -1;
 	}
 	if (sr & FLASH_SR_ERROR_MASK) {
 		DEBUG("stm32h7_flash_write: error sr %08" PRIx32 "\n", sr);
@@ -385,24 +394,24 @@ static bool stm32h7_cmd_erase(target *t, int bank_mask)
 	/* Read FLASH_SR to poll for QW bit */
 	if (do_bank1) {
 		uint32_t regbase = FPEC1_BASE;
-		while (target_mem_read32(t, regbase + FLASH_SR) & FLASH_SR_QW) {
-//			target_mem_write32(t, H7_IWDG_BASE, 0x0000aaaa);
+		int res;
+		while ((res = target_mem_poll32(t, regbase + FLASH_SR, FLASH_SR_QW,
+		                                0, 500, NULL)) > 0)
 			tc_printf(t, "\b%c", spinner[spinindex++ % 4]);
-			if(target_check_error(t)) {
-				DEBUG("ME bank1: comm failed\n");
-				goto done;
-			}
+		if (res < 0) {
+			DEBUG("ME bank1: comm failed\n");
+			goto done;
 		}
 	}
 	if (do_bank2) {
 		uint32_t regbase = FPEC2_BASE;
-		while (target_mem_read32(t, regbase + FLASH_SR) & FLASH_SR_QW) {
-//			target_mem_write32(t, H7_IWDG_BASE 0x0000aaaa);
+		int res;
+		while ((res = target_mem_poll32(t, regbase + FLASH_SR, FLASH_SR_QW,
+		                                0, 500, NULL)) > 0)
 			tc_printf(t, "\b%c", spinner[spinindex++ % 4]);
-			if(target_check_error(t)) {
-				DEBUG("ME bank2: comm failed\n");
-				goto done;
-			}
+		if (res < 0) {
+			DEBUG("ME bank2: comm failed\n");
+			goto done;
 		}
 	}
 
@@ -466,12 +475,14 @@ static int stm32h7_crc_bank(target *t, uint32_t bank)
 
 	if (stm32h7_flash_unlock(t, bank) == false)
 			return -1;
-	uint32_t cr = FLASH_CR_CRC_EN;
-	target_mem_write32(t, regbase + FLASH_CR, cr);
 	uint32_t crccr= FLASH_CRCCR_CRC_BURST_3 |
 		FLASH_CRCCR_CLEAN_CRC | FLASH_CRCCR_ALL_BANK;
-	target_mem_write32(t, regbase + FLASH_CRCCR, crccr);
-	target_mem_write32(t, regbase + FLASH_CRCCR, crccr | FLASH_CRCCR_START_CRC);
+	const struct target_mem32 crc[] = {
+		{regbase + FLASH_CR, FLASH_CR_CRC_EN},
+		{regbase + FLASH_CRCCR, crccr},
+		{regbase + FLASH_CRCCR, crccr | FLASH_CRCCR_START_CRC},
+	};
+	target_mem_write32_batch(t, crc, ARRAY_NUMELEM(crc));
 	uint32_t sr;
 	while ((sr = target_mem_read32(t, regbase + FLASH_SR)) & FLASH_SR_CRC_BUSY) {
 		if(target_check_error(t)) {
@@ -320,11 +320,14 @@ static bool stm32lx_nvm_prog_data_unlock(target* t, uint32_t nvm)
 {
         /* Always lock first because that's the only way to know that the
            unlock can succeed on the STM32L0's. */
-        target_mem_write32(t, STM32Lx_NVM_PECR(nvm),  STM32Lx_NVM_PECR_PELOCK);
-        target_mem_write32(t, STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY1);
-        target_mem_write32(t, STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY2);
-        target_mem_write32(t, STM32Lx_NVM_PRGKEYR(nvm), STM32Lx_NVM_PRGKEY1);
-        target_mem_write32(t, STM32Lx_NVM_PRGKEYR(nvm), STM32Lx_NVM_PRGKEY2);
+        const struct target_mem32 unlock[] = {
+                {STM32Lx_NVM_PECR(nvm),  STM32Lx_NVM_PECR_PELOCK},
+                {STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY1},
+                {STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY2},
+                {STM32Lx_NVM_PRGKEYR(nvm), STM32Lx_NVM_PRGKEY1},
+                {STM32Lx_NVM_PRGKEYR(nvm), STM32Lx_NVM_PRGKEY2},
+        };
+        target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
 
         return !(target_mem_read32(t, STM32Lx_NVM_PECR(nvm))
                  & STM32Lx_NVM_PECR_PRGLOCK);
@@ -337,11 +340,14 @@ static bool stm32lx_nvm_opt_unlock(target *t, uint32_t nvm)
 {
         /* Always lock first because that's the only way to know that the
            unlock can succeed on the STM32L0's. */
-        target_mem_write32(t, STM32Lx_NVM_PECR(nvm),  STM32Lx_NVM_PECR_PELOCK);
-        target_mem_write32(t, STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY1);
-        target_mem_write32(t, STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY2);
-        target_mem_write32(t, STM32Lx_NVM_OPTKEYR(nvm), STM32Lx_NVM_OPTKEY1);
-        target_mem_write32(t, STM32Lx_NVM_OPTKEYR(nvm), STM32Lx_NVM_OPTKEY2);
+        const struct target_mem32 unlock[] = {
+                {STM32Lx_NVM_PECR(nvm),  STM32Lx_NVM_PECR_PELOCK},
+                {STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY1},
+                {STM32Lx_NVM_PEKEYR(nvm),  STM32Lx_NVM_PEKEY2},
+                {STM32Lx_NVM_OPTKEYR(nvm), STM32Lx_NVM_OPTKEY1},
+                {STM32Lx_NVM_OPTKEYR(nvm), STM32Lx_NVM_OPTKEY2},
+        };
+        target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
 
         return !(target_mem_read32(t, STM32Lx_NVM_PECR(nvm))
                  & STM32Lx_NVM_PECR_OPTLOCK);
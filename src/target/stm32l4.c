@@ -103,6 +103,9 @@ static int stm32l4_flash_write(struct target_flash *f,
 
 #define SR_ERROR_MASK	0xF2
 
+/* Upper bound for any single flash operation */
+#define FLASH_BSY_TIMEOUT_MS	5000
+
 /* Used in STM32L47*/
 #define OR_DUALBANK		(1 << 21)
 /* Used in STM32L47R*/
@@ -387,15 +390,17 @@ static void stm32l4_flash_unlock(target *t)
 {
 	if (target_mem_read32(t, FLASH_CR) & FLASH_CR_LOCK) {
 		/* Enable FPEC controller access */
-		target_mem_write32(t, FLASH_KEYR, KEY1);
-		target_mem_write32(t, FLASH_KEYR, KEY2);
+		const struct target_mem32 unlock[] = {
+			{FLASH_KEYR, KEY1},
+			{FLASH_KEYR, KEY2},
+		};
+		target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
 	}
 }
 
 static int stm32l4_flash_erase(struct target_flash *f, target_addr addr, size_t len)
 {
 	target *t = f->t;
-	uint16_t sr;
 	uint32_t bank1_start = ((struct stm32l4_flash *)f)->bank1_start;
 	uint32_t page;
 	uint32_t blocksize = f->blocksize;
@@ -403,11 +408,12 @@ static int stm32l4_flash_erase(struct target_flash *f, target_addr addr, size_t
 	stm32l4_flash_unlock(t);
 
 	/* Read FLASH_SR to poll for BSY bit */
-	while(target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return -1;
+	uint32_t sr;
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr))
+		return -1;
 	/* Fixme: OPTVER always set after reset! Wrong option defaults?*/
-	target_mem_write32(t, FLASH_SR, target_mem_read32(t, FLASH_SR));
+	target_mem_write32(t, FLASH_SR, sr);
 	page = (addr - 0x08000000) / blocksize;
 	while(len) {
 		uint32_t cr;
@@ -415,16 +421,19 @@ static int stm32l4_flash_erase(struct target_flash *f, target_addr addr, size_t
 		cr = FLASH_CR_PER | (page << FLASH_CR_PAGE_SHIFT );
 		if (addr >= bank1_start)
 			cr |= FLASH_CR_BKER;
-		/* Flash page erase instruction */
-		target_mem_write32(t, FLASH_CR, cr);
-		/* write address to FMA */
-		cr |= FLASH_CR_STRT;
-		target_mem_write32(t, FLASH_CR, cr);
+		const struct target_mem32 erase[] = {
+			/* Flash page erase instruction */
+			{FLASH_CR, cr},
+			/* Flash page erase start instruction */
+			{FLASH_CR, cr | FLASH_CR_STRT},
+		};
+		if (target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase)))
+			return -1;
 
 		/* Read FLASH_SR to poll for BSY bit */
-		while(target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-			if(target_check_error(t))
-				return -1;
+		if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+		                      FLASH_BSY_TIMEOUT_MS, &sr))
+			return -1;
 		if (len > blocksize)
 			len  -= blocksize;
 		else
@@ -434,7 +443,6 @@ static int stm32l4_flash_erase(struct target_flash *f, target_addr addr, size_t
 	}
 
 	/* Check for error */
-	sr = target_mem_read32(t, FLASH_SR);
 	if(sr & FLASH_SR_ERROR_MASK)
 		return -1;
 
@@ -449,13 +457,11 @@ static int stm32l4_flash_write(struct target_flash *f,
 	target_mem_write(t, dest, src, len);
 	/* Wait for completion or an error */
 	uint32_t sr;
-	do {
-		sr = target_mem_read32(t, FLASH_SR);
-		if (target_check_error(t)) {
-			DEBUG("stm32l4 flash write: comm error\n");
-			return -1;
-		}
-	} while (sr & FLASH_SR_BSY);
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr)) {
+		DEBUG("stm32l4 flash write: comm error\n");
+		return -1;
+	}
 
 	if(sr & FLASH_SR_ERROR_MASK) {
 		DEBUG("stm32l4 flash write error: sr 0x%" PRIu32 "\n", sr);
@@ -469,18 +475,19 @@ static bool stm32l4_cmd_erase(target *t, uint32_t action)
 	stm32l4_flash_unlock(t);
 	/* Erase time is 25 ms. No need for a spinner.*/
 	/* Flash erase action start instruction */
-	target_mem_write32(t, FLASH_CR, action);
-	target_mem_write32(t, FLASH_CR, action | FLASH_CR_STRT);
+	const struct target_mem32 erase[] = {
+		{FLASH_CR, action},
+		{FLASH_CR, action | FLASH_CR_STRT},
+	};
+	target_mem_write32_batch(t, erase, ARRAY_NUMELEM(erase));
 
 	/* Read FLASH_SR to poll for BSY bit */
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY) {
-		if(target_check_error(t)) {
-			return false;
-		}
-	}
+	uint32_t sr;
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, &sr))
+		return false;
 
 	/* Check for error */
-	uint16_t sr = target_mem_read32(t, FLASH_SR);
 	if (sr & FLASH_SR_ERROR_MASK)
 		return false;
 	return true;
@@ -524,21 +531,29 @@ static bool stm32l4_option_write(
 {
 	tc_printf(t, "Device will lose connection. Rescan!\n");
 	stm32l4_flash_unlock(t);
-	target_mem_write32(t, FLASH_OPTKEYR, OPTKEY1);
-	target_mem_write32(t, FLASH_OPTKEYR, OPTKEY2);
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return true;
-	for (int i = 0; i < len; i++)
-		target_mem_write32(t, FPEC_BASE + i2offset[i], values[i]);
-	target_mem_write32(t, FLASH_CR, FLASH_CR_OPTSTRT);
-	while (target_mem_read32(t, FLASH_SR) & FLASH_SR_BSY)
-		if(target_check_error(t))
-			return true;
+	const struct target_mem32 unlock[] = {
+		{FLASH_OPTKEYR, OPTKEY1},
+		{FLASH_OPTKEYR, OPTKEY2},
+	};
+	target_mem_write32_batch(t, unlock, ARRAY_NUMELEM(unlock));
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, NULL))
+		return true;
+	struct target_mem32 opts[len + 1];
+	for (int i = 0; i < len; i++) {
+		opts[i].addr = FPEC_BASE + i2offset[i];
+		opts[i].value = values[i];
+	}
+	opts[len].addr = FLASH_CR;
+	opts[len].value = FLASH_CR_OPTSTRT;
+	target_mem_write32_batch(t, opts, len + 1);
+	if (target_mem_poll32(t, FLASH_SR, FLASH_SR_BSY, 0,
+	                      FLASH_BSY_TIMEOUT_MS, NULL))
+		return true;
 	target_mem_write32(t, FLASH_CR, FLASH_CR_OBL_LAUNCH);
-	while (target_mem_read32(t, FLASH_CR) & FLASH_CR_OBL_LAUNCH)
-		if(target_check_error(t))
-			return true;
+	if (target_mem_poll32(t, FLASH_CR, FLASH_CR_OBL_LAUNCH, 0,
+	                      FLASH_BSY_TIMEOUT_MS, NULL))
+		return true;
 	target_mem_write32(t, FLASH_CR, FLASH_CR_LOCK);
 	return false;
 }
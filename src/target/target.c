@@ -21,9 +21,17 @@
 #include "general.h"
 #include "target.h"
 #include "target_internal.h"
+#include "crc32.h"
 
 #include <stdarg.h>
 
+/* Largest erase block buffered as a whole in incremental mode */
+#if defined(PC_HOSTED)
+# define FLASH_INCREMENTAL_MAX_BLOCK	(256 * 1024)
+#else
+# define FLASH_INCREMENTAL_MAX_BLOCK	2048
+#endif
+
 target *target_list = NULL;
 
 static int target_flash_write_buffered(struct target_flash *f,
@@ -89,9 +97,12 @@ void target_mem_map_free(target *t)
 		void * next = t->flash->next;
 		if (t->flash->buf)
 			free(t->flash->buf);
+		free(t->flash->erase_pending);
 		free(t->flash);
 		t->flash = next;
 	}
+	free(t->flash_cache);
+	t->flash_cache = NULL;
 }
 
 void target_list_free(void)
@@ -110,8 +121,10 @@ void target_list_free(void)
 			target_list->commands = tc;
 		}
 		target_mem_map_free(target_list);
+		free(target_list->regs_cache);
 		while (target_list->bw_list) {
 			void * next = target_list->bw_list->next;
+			agent_expr_free(target_list->bw_list->cond);
 			free(target_list->bw_list);
 			target_list->bw_list = next;
 		}
@@ -140,6 +153,8 @@ void target_add_commands(target *t, const struct command_s *cmds, const char *na
 	tc->next = NULL;
 }
 
+static void flash_cache_invalidate(target *t);
+
 target *target_attach_n(int n, struct target_controller *tc)
 {
 	target *t;
@@ -160,6 +175,8 @@ target *target_attach(target *t, struct target_controller *tc)
 	if (!t->attach(t))
 		return NULL;
 
+	t->regs_cached = t->regs_dirty = false;
+	flash_cache_invalidate(t);
 	t->attached = true;
 	return t;
 }
@@ -232,9 +249,135 @@ static struct target_flash *flash_for_addr(target *t, uint32_t addr)
 	return NULL;
 }
 
+/* Read-only cache of flash contents. Pages are kept for one halt: they
+ * are dropped when the halt is seen, on resume and whenever the flash may
+ * change: on erase, write, reset, attach and target monitor commands.
+ * Only small reads, as GDB does for disassembly and constants, use the
+ * cache. Larger reads are faster in one piece. */
+#if defined(PC_HOSTED)
+#define FLASH_CACHE_PAGE_SIZE	256
+#define FLASH_CACHE_PAGES	256
+#else
+#define FLASH_CACHE_PAGE_SIZE	64
+#define FLASH_CACHE_PAGES	8
+#endif
+/* Never a page address, marks an unused slot */
+#define FLASH_CACHE_EMPTY	1
+
+struct target_flash_cache {
+	target_addr page[FLASH_CACHE_PAGES];
+	uint8_t data[FLASH_CACHE_PAGES][FLASH_CACHE_PAGE_SIZE];
+};
+
+static void flash_cache_invalidate(target *t)
+{
+	if (!t->flash_cache)
+		return;
+	for (size_t i = 0; i < FLASH_CACHE_PAGES; i++)
+		t->flash_cache->page[i] = FLASH_CACHE_EMPTY;
+}
+
+/* For flash changes the flash API doesn't see, like monitor commands */
+void target_flash_cache_flush(target *t)
+{
+	flash_cache_invalidate(t);
+}
+
+/* Cached copy of the page holding addr, read from the target if needed.
+ * NULL if the page is not entirely inside one flash region. */
+static const uint8_t *flash_cache_page(target *t, target_addr addr)
+{
+	target_addr page = addr & ~(target_addr)(FLASH_CACHE_PAGE_SIZE - 1);
+	struct target_flash *f = flash_for_addr(t, page);
+
+	if (!f || (page + FLASH_CACHE_PAGE_SIZE > f->start + f->length))
+		return NULL;
+	if (!t->flash_cache) {
+		t->flash_cache = malloc(sizeof(*t->flash_cache));
+		if (!t->flash_cache) {	/* malloc failed: heap exhaustion */
+			DEBUG("malloc: failed in %s\n", __func__);
+			return NULL;
+		}
+		flash_cache_invalidate(t);
+	}
+
+	struct target_flash_cache *c = t->flash_cache;
+	size_t i = (page / FLASH_CACHE_PAGE_SIZE) % FLASH_CACHE_PAGES;
+	if (c->page[i] != page) {
+		c->page[i] = FLASH_CACHE_EMPTY;
+		t->mem_read(t, c->data[i], page, FLASH_CACHE_PAGE_SIZE);
+		if (target_check_error(t))
+			return NULL;
+		c->page[i] = page;
+	}
+	return c->data[i];
+}
+
+static bool flash_cache_read(target *t, void *dest, target_addr src, size_t len)
+{
+	uint8_t *d = dest;
+
+	if (!t->flash || (len > FLASH_CACHE_PAGE_SIZE))
+		return false;
+	while (len) {
+		const uint8_t *page = flash_cache_page(t, src);
+		if (!page)
+			return false;
+		size_t offset = src % FLASH_CACHE_PAGE_SIZE;
+		size_t n = MIN(len, FLASH_CACHE_PAGE_SIZE - offset);
+		memcpy(d, page + offset, n);
+		d += n;
+		src += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* In incremental mode erases are only recorded. A block is erased when
+ * it is written with data it does not hold yet, or from
+ * target_flash_done() if it is not blank. */
+static bool flash_defer_erase(struct target_flash *f,
+                              target_addr addr, size_t len)
+{
+	if ((f->blocksize > FLASH_INCREMENTAL_MAX_BLOCK) ||
+	    (f->blocksize % f->buf_size) || (f->buf && !f->erase_pending))
+		return false;
+	if (!f->erase_pending) {
+		size_t blocks = f->length / f->blocksize;
+		f->erase_pending = calloc(1, (blocks + 7) / 8);
+		if (!f->erase_pending) {	/* calloc failed: heap exhaustion */
+			DEBUG("calloc: failed in %s\n", __func__);
+			return false;
+		}
+	}
+	size_t first = (addr - f->start) / f->blocksize;
+	size_t last = (addr + len - 1 - f->start) / f->blocksize;
+	for (size_t block = first; block <= last; block++)
+		f->erase_pending[block / 8] |= 1 << (block % 8);
+	return true;
+}
+
+/* Check and clear the deferred erase of the block at addr */
+static bool flash_take_erase(struct target_flash *f, target_addr addr)
+{
+	size_t block = (addr - f->start) / f->blocksize;
+	uint8_t bit = 1 << (block % 8);
+	bool pending = f->erase_pending[block / 8] & bit;
+	f->erase_pending[block / 8] &= ~bit;
+	return pending;
+}
+
+static bool flash_block_matches(struct target_flash *f,
+                                target_addr addr, const void *buf)
+{
+	return generic_crc32(f->t, addr, f->blocksize) ==
+	       crc32_buffer(buf, f->blocksize);
+}
+
 int target_flash_erase(target *t, target_addr addr, size_t len)
 {
 	int ret = 0;
+	flash_cache_invalidate(t);
 	while (len) {
 		struct target_flash *f = flash_for_addr(t, addr);
 		if (!f) {
@@ -243,7 +386,9 @@ int target_flash_erase(target *t, target_addr addr, size_t len)
 		}
 		size_t tmptarget = MIN(addr + len, f->start + f->length);
 		size_t tmplen = tmptarget - addr;
-		ret |= f->erase(f, addr, tmplen);
+		if (!(target_flash_incremental &&
+		      flash_defer_erase(f, addr, tmplen)))
+			ret |= f->erase(f, addr, tmplen);
 		addr += tmplen;
 		len -= tmplen;
 	}
@@ -254,6 +399,7 @@ int target_flash_write(target *t,
                        target_addr dest, const void *src, size_t len)
 {
 	int ret = 0;
+	flash_cache_invalidate(t);
 	while (len) {
 		struct target_flash *f = flash_for_addr(t, dest);
 		size_t tmptarget = MIN(dest + len, f->start + f->length);
@@ -268,6 +414,7 @@ int target_flash_write(target *t,
 
 int target_flash_done(target *t)
 {
+	flash_cache_invalidate(t);
 	for (struct target_flash *f = t->flash; f; f = f->next) {
 		int tmp = target_flash_done_buffered(f);
 		if (tmp)
@@ -281,14 +428,95 @@ int target_flash_done(target *t)
 	return 0;
 }
 
+/* Whole erase blocks are buffered while erases are deferred */
+static size_t flash_buf_size(struct target_flash *f)
+{
+	return f->erase_pending ? f->blocksize : f->buf_size;
+}
+
+/* True if buf holds nothing but the erased value, compared a word at a time */
+static bool flash_buf_is_blank(struct target_flash *f, const uint8_t *buf,
+                               size_t len)
+{
+	const uint32_t blank = f->erased * 0x01010101U;
+	size_t i = 0;
+
+	for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+		uint32_t word;
+		memcpy(&word, buf + i, sizeof(word));
+		if (word != blank)
+			return false;
+	}
+	for (; i < len; i++)
+		if (buf[i] != f->erased)
+			return false;
+	return true;
+}
+
+/* Write one chunk of buf_size bytes. Erased flash already holds a blank
+ * chunk, so it is not programmed. */
+static int flash_chunk_write(struct target_flash *f,
+                             target_addr dest, const uint8_t *src)
+{
+	if (flash_buf_is_blank(f, src, f->buf_size))
+		return 0;
+	return f->write(f, dest, src, f->buf_size);
+}
+
+static int flash_buf_write(struct target_flash *f)
+{
+	if (!f->erase_pending)
+		return flash_chunk_write(f, f->buf_addr, f->buf);
+
+	if (flash_take_erase(f, f->buf_addr)) {
+		if (flash_block_matches(f, f->buf_addr, f->buf)) {
+			DEBUG("Flash block at 0x%08" PRIx32 " unchanged\n",
+			      f->buf_addr);
+			return 0;
+		}
+		int ret = f->erase(f, f->buf_addr, f->blocksize);
+		if (ret)
+			return ret;
+	}
+	int ret = 0;
+	for (size_t i = 0; i < f->blocksize; i += f->buf_size)
+		ret |= flash_chunk_write(f, f->buf_addr + i,
+		                         (uint8_t *)f->buf + i);
+	return ret;
+}
+
+/* Erase the blocks left over from incremental mode which are not blank */
+static int flash_erase_pending(struct target_flash *f)
+{
+	size_t blocks = f->length / f->blocksize;
+	uint32_t blank_crc = 0;
+	bool have_blank_crc = false;
+	int ret = 0;
+
+	for (size_t block = 0; block < blocks; block++) {
+		target_addr addr = f->start + block * f->blocksize;
+		if (!flash_take_erase(f, addr))
+			continue;
+		if (!have_blank_crc) {
+			memset(f->buf, f->erased, f->blocksize);
+			blank_crc = crc32_buffer(f->buf, f->blocksize);
+			have_blank_crc = true;
+		}
+		if (generic_crc32(f->t, addr, f->blocksize) != blank_crc)
+			ret |= f->erase(f, addr, f->blocksize);
+	}
+	return ret;
+}
+
 int target_flash_write_buffered(struct target_flash *f,
                                 target_addr dest, const void *src, size_t len)
 {
 	int ret = 0;
+	size_t buf_size = flash_buf_size(f);
 
 	if (f->buf == NULL) {
 		/* Allocate flash sector buffer */
-		f->buf = malloc(f->buf_size);
+		f->buf = malloc(buf_size);
 		if (!f->buf) {			/* malloc failed: heap exhaustion */
 			DEBUG("malloc: failed in %s\n", __func__);
 			return 1;
@@ -296,20 +524,19 @@ int target_flash_write_buffered(struct target_flash *f,
 		f->buf_addr = -1;
 	}
 	while (len) {
-		uint32_t offset = dest % f->buf_size;
+		uint32_t offset = dest % buf_size;
 		uint32_t base = dest - offset;
 		if (base != f->buf_addr) {
 			if (f->buf_addr != (uint32_t)-1) {
 				/* Write sector to flash if valid */
-				ret |= f->write(f, f->buf_addr,
-				                f->buf, f->buf_size);
+				ret |= flash_buf_write(f);
 			}
 			/* Setup buffer for a new sector */
 			f->buf_addr = base;
-			memset(f->buf, f->erased, f->buf_size);
+			memset(f->buf, f->erased, buf_size);
 		}
 		/* Copy chunk into sector buffer */
-		size_t sectlen = MIN(f->buf_size - offset, len);
+		size_t sectlen = MIN(buf_size - offset, len);
 		memcpy(f->buf + offset, src, sectlen);
 		dest += sectlen;
 		src += sectlen;
@@ -323,11 +550,21 @@ int target_flash_done_buffered(struct target_flash *f)
 	int ret = 0;
 	if ((f->buf != NULL) &&(f->buf_addr != (uint32_t)-1)) {
 		/* Write sector to flash if valid */
-		ret = f->write(f, f->buf_addr, f->buf, f->buf_size);
+		ret = flash_buf_write(f);
 		f->buf_addr = -1;
-		free(f->buf);
-		f->buf = NULL;
 	}
+	if (f->erase_pending) {
+		if (!f->buf)
+			f->buf = malloc(f->blocksize);
+		if (f->buf)
+			ret |= flash_erase_pending(f);
+		else
+			ret = 1;
+		free(f->erase_pending);
+		f->erase_pending = NULL;
+	}
+	free(f->buf);
+	f->buf = NULL;
 
 	return ret;
 }
@@ -335,6 +572,7 @@ int target_flash_done_buffered(struct target_flash *f)
 /* Wrapper functions */
 void target_detach(target *t)
 {
+	target_regs_cache_flush(t);
 	t->detach(t);
 	t->attached = false;
 #if defined(PC_HOSTED)
@@ -349,28 +587,27 @@ bool target_attached(target *t) { return t->attached; }
 /* Memory access functions */
 int target_mem_read(target *t, void *dest, target_addr src, size_t len)
 {
+	if (flash_cache_read(t, dest, src, len))
+		return 0;
 	t->mem_read(t, dest, src, len);
 	return target_check_error(t);
 }
 
 int target_mem_write(target *t, target_addr dest, const void *src, size_t len)
 {
+	if (len && (flash_for_addr(t, dest) || flash_for_addr(t, dest + len - 1)))
+		flash_cache_invalidate(t);
 	t->mem_write(t, dest, src, len);
 	return target_check_error(t);
 }
 
-/* Register access functions */
-ssize_t target_reg_read(target *t, int reg, void *data, size_t max)
-{
-	return t->reg_read(t, reg, data, max);
-}
-
-ssize_t target_reg_write(target *t, int reg, const void *data, size_t size)
-{
-	return t->reg_write(t, reg, data, size);
-}
-
-void target_regs_read(target *t, void *data)
+/* Register access functions
+ *
+ * Registers are cached from the first read after a halt until the target
+ * runs again. Writes only update the cache and are written back by
+ * target_halt_resume().
+ */
+static void target_regs_fetch(target *t, void *data)
 {
 	if (t->regs_read) {
 		t->regs_read(t, data);
@@ -380,7 +617,8 @@ void target_regs_read(target *t, void *data)
 		x += t->reg_read(t, i++, data + x, t->regs_size - x);
 	}
 }
-void target_regs_write(target *t, const void *data)
+
+static void target_regs_store(target *t, const void *data)
 {
 	if (t->regs_write) {
 		t->regs_write(t, data);
@@ -391,38 +629,254 @@ void target_regs_write(target *t, const void *data)
 	}
 }
 
+static bool target_regs_cache_alloc(target *t)
+{
+	if (!t->regs_cache && t->regs_size) {
+		t->regs_cache = malloc(t->regs_size);
+		if (!t->regs_cache)	/* malloc failed: heap exhaustion */
+			DEBUG("malloc: failed in %s\n", __func__);
+	}
+	return t->regs_cache != NULL;
+}
+
+static bool target_regs_cache_fill(target *t)
+{
+	if (t->regs_cached)
+		return true;
+	if (!target_regs_cache_alloc(t))
+		return false;
+	target_regs_fetch(t, t->regs_cache);
+	t->regs_cached = !target_check_error(t);
+	return t->regs_cached;
+}
+
+void target_regs_cache_flush(target *t)
+{
+	if (t->regs_dirty)
+		target_regs_store(t, t->regs_cache);
+	t->regs_dirty = false;
+	t->regs_cached = false;
+}
+
+/* Offset of reg in the cache, or -1 if it can not be served from there */
+static ssize_t target_reg_offset(target *t, int reg, size_t max)
+{
+	size_t offset = reg * t->reg_size;
+
+	if (!t->reg_size || (reg < 0) || (max < t->reg_size) ||
+	    (offset + t->reg_size > t->regs_size))
+		return -1;
+	return offset;
+}
+
+size_t target_reg_layout(target *t, int reg, size_t *offset)
+{
+	ssize_t off = target_reg_offset(t, reg, t->reg_size);
+
+	if (off < 0)
+		return 0;
+	*offset = off;
+	return t->reg_size;
+}
+
+ssize_t target_reg_read(target *t, int reg, void *data, size_t max)
+{
+	ssize_t offset = target_reg_offset(t, reg, max);
+
+	if ((offset >= 0) && target_regs_cache_fill(t)) {
+		memcpy(data, t->regs_cache + offset, t->reg_size);
+		return t->reg_size;
+	}
+	target_regs_cache_flush(t);
+	return t->reg_read(t, reg, data, max);
+}
+
+ssize_t target_reg_write(target *t, int reg, const void *data, size_t size)
+{
+	ssize_t offset = target_reg_offset(t, reg, size);
+
+	if ((offset >= 0) && target_regs_cache_fill(t)) {
+		memcpy(t->regs_cache + offset, data, t->reg_size);
+		t->regs_dirty = true;
+		return t->reg_size;
+	}
+	target_regs_cache_flush(t);
+	return t->reg_write(t, reg, data, size);
+}
+
+void target_regs_read(target *t, void *data)
+{
+	if (target_regs_cache_fill(t))
+		memcpy(data, t->regs_cache, t->regs_size);
+	else
+		target_regs_fetch(t, data);
+}
+
+void target_regs_write(target *t, const void *data)
+{
+	if (!target_regs_cache_alloc(t)) {
+		target_regs_store(t, data);
+		return;
+	}
+	memcpy(t->regs_cache, data, t->regs_size);
+	t->regs_cached = true;
+	t->regs_dirty = true;
+}
+
 /* Halt/resume functions */
-void target_reset(target *t) { t->reset(t); }
+void target_reset(target *t)
+{
+	t->regs_cached = t->regs_dirty = false;
+	flash_cache_invalidate(t);
+	t->reset(t);
+}
+
 void target_halt_request(target *t) { t->halt_request(t); }
+
+/* Evaluate the conditions of bw. Errors count as true, so the halt is
+ * reported. */
+static bool target_breakwatch_cond_true(target *t, struct breakwatch *bw)
+{
+	for (struct agent_expr *x = bw->cond; x; x = x->next) {
+		uint64_t val;
+		if (agent_expr_eval(t, x, &val, NULL, NULL) || val)
+			return true;
+	}
+	return false;
+}
+
+static bool target_breakwatch_at(struct breakwatch *bw, target_addr addr)
+{
+	return (bw->type <= TARGET_BREAK_HARD) && (bw->addr == addr);
+}
+
+/* Wait up to ms for the target to halt */
+static enum target_halt_reason target_halt_wait(target *t, uint32_t ms)
+{
+	enum target_halt_reason reason;
+	platform_timeout timeout;
+
+	platform_timeout_set(&timeout, ms);
+	while (!(reason = t->halt_poll(t, NULL)) &&
+	       !platform_timeout_is_expired(&timeout))
+		;
+	return reason;
+}
+
+/* Step over the breakpoints at addr with them removed and resume.
+ * Returns the reason of a halt other than the step, which is then to be
+ * reported. */
+static enum target_halt_reason target_breakwatch_step_over(target *t,
+                                                           target_addr addr)
+{
+	enum target_halt_reason reason;
+	struct breakwatch *bw;
+
+	for (bw = t->bw_list; bw; bw = bw->next) {
+		if (!target_breakwatch_at(bw, addr) || !t->breakwatch_clear(t, bw))
+			continue;
+		/* Put back the ones already cleared, the halt is reported */
+		for (struct breakwatch *c = t->bw_list; c != bw; c = c->next)
+			if (target_breakwatch_at(c, addr))
+				t->breakwatch_set(t, c);
+		return TARGET_HALT_BREAKPOINT;
+	}
+	target_halt_resume(t, true);
+	reason = target_halt_wait(t, 100);
+	if (!reason) {
+		/* The step didn't end, stop the core and report that halt
+		 * instead of leaving it in step mode */
+		DEBUG("Step over breakpoint at 0x%08" PRIx32 " timed out\n", addr);
+		t->halt_request(t);
+		reason = target_halt_wait(t, 100);
+		if (!reason)
+			reason = TARGET_HALT_ERROR;
+	}
+	for (bw = t->bw_list; bw; bw = bw->next)
+		if (target_breakwatch_at(bw, addr) && t->breakwatch_set(t, bw))
+			DEBUG("Can't set breakpoint at 0x%08" PRIx32 " again\n",
+			      addr);
+	if (reason != TARGET_HALT_STEPPING) {
+		t->stepping = false;
+		return reason;
+	}
+	target_halt_resume(t, false);
+	return TARGET_HALT_RUNNING;
+}
+
+/* A breakpoint halt is only reported if one of the breakpoints at the PC
+ * has no conditions, one of its conditions is true or a hook asks for it.
+ * Otherwise the target is resumed without GDB hearing of it. The PC is
+ * r15 in the ARM register numbering used by all our targets. */
+static enum target_halt_reason target_breakwatch_hit(target *t)
+{
+	struct breakwatch *bw;
+	uint8_t pc[4];
+	bool found = false, report = false;
+
+	for (bw = t->bw_list; bw; bw = bw->next)
+		if (bw->cond || bw->hook)
+			break;
+	/* Spare the register read while only plain breakpoints are set */
+	if (!bw || (target_reg_read(t, 15, pc, sizeof(pc)) != sizeof(pc)))
+		return TARGET_HALT_BREAKPOINT;
+	target_addr addr = pc[0] | (pc[1] << 8) | (pc[2] << 16) |
+	                   ((uint32_t)pc[3] << 24);
+
+	for (bw = t->bw_list; bw; bw = bw->next) {
+		if (!target_breakwatch_at(bw, addr))
+			continue;
+		found = true;
+		if (bw->hook)
+			report |= bw->hook(t, bw->hook_arg);
+		else if (!bw->cond || target_breakwatch_cond_true(t, bw))
+			report = true;
+	}
+	if (!found || report)
+		return TARGET_HALT_BREAKPOINT;
+	return target_breakwatch_step_over(t, addr);
+}
+
 enum target_halt_reason target_halt_poll(target *t, target_addr *watch)
 {
-	return t->halt_poll(t, watch);
+	enum target_halt_reason reason = t->halt_poll(t, watch);
+
+	/* Callers stop polling at the halt, so this is its first report.
+	 * Pages read while the target ran may have been rewritten since. */
+	if (reason != TARGET_HALT_RUNNING)
+		flash_cache_invalidate(t);
+	if ((reason == TARGET_HALT_BREAKPOINT) && !t->stepping)
+		reason = target_breakwatch_hit(t);
+	return reason;
 }
 
-void target_halt_resume(target *t, bool step) { t->halt_resume(t, step); }
+void target_halt_resume(target *t, bool step)
+{
+	target_regs_cache_flush(t);
+	/* Flash contents are only trusted for the length of one halt */
+	flash_cache_invalidate(t);
+	t->stepping = step;
+	t->halt_resume(t, step);
+}
 
 /* Break-/watchpoint functions */
-int target_breakwatch_set(target *t,
-                          enum target_breakwatch type, target_addr addr, size_t len)
+
+/* Set bw on the target and add a heap copy to the list */
+static int target_breakwatch_add(target *t, struct breakwatch *bw)
 {
-	struct breakwatch bw = {
-		.type = type,
-		.addr = addr,
-		.size = len,
-	};
 	int ret = 1;
 
 	if (t->breakwatch_set)
-		ret = t->breakwatch_set(t, &bw);
+		ret = t->breakwatch_set(t, bw);
 
 	if (ret == 0) {
 		/* Success, make a heap copy */
-		struct breakwatch *bwm = malloc(sizeof bw);
+		struct breakwatch *bwm = malloc(sizeof(*bw));
 		if (!bwm) {			/* malloc failed: heap exhaustion */
 			DEBUG("malloc: failed in %s\n", __func__);
 			return 1;
 		}
-		memcpy(bwm, &bw, sizeof(bw));
+		memcpy(bwm, bw, sizeof(*bw));
 
 		/* Add to list */
 		bwm->next = t->bw_list;
@@ -432,19 +886,12 @@ int target_breakwatch_set(target *t,
 	return ret;
 }
 
-int target_breakwatch_clear(target *t,
-                            enum target_breakwatch type, target_addr addr, size_t len)
+/* Clear bw on the target and remove it from the list, bwp is the entry
+ * before it */
+static int target_breakwatch_remove(target *t, struct breakwatch *bwp,
+                                    struct breakwatch *bw)
 {
-	struct breakwatch *bwp = NULL, *bw;
 	int ret = 1;
-	for (bw = t->bw_list; bw; bwp = bw, bw = bw->next)
-		if ((bw->type == type) &&
-		    (bw->addr == addr) &&
-		    (bw->size == len))
-			break;
-
-	if (bw == NULL)
-		return -1;
 
 	if (t->breakwatch_clear)
 		ret = t->breakwatch_clear(t, bw);
@@ -455,11 +902,89 @@ int target_breakwatch_clear(target *t,
 		} else {
 			bwp->next = bw->next;
 		}
+		agent_expr_free(bw->cond);
 		free(bw);
 	}
 	return ret;
 }
 
+int target_breakwatch_set(target *t,
+                          enum target_breakwatch type, target_addr addr, size_t len)
+{
+	return target_breakwatch_set_cond(t, type, addr, len, NULL);
+}
+
+int target_breakwatch_set_cond(target *t, enum target_breakwatch type,
+                               target_addr addr, size_t len,
+                               struct agent_expr *cond)
+{
+	struct breakwatch bw = {
+		.type = type,
+		.addr = addr,
+		.size = len,
+		.cond = cond,
+	};
+
+	/* GDB sets a breakpoint again when its conditions change */
+	for (struct breakwatch *bwp = t->bw_list; bwp; bwp = bwp->next) {
+		if (!bwp->hook && (bwp->type == type) && (bwp->addr == addr) &&
+		    (bwp->size == len)) {
+			agent_expr_free(bwp->cond);
+			bwp->cond = cond;
+			return 0;
+		}
+	}
+
+	int ret = target_breakwatch_add(t, &bw);
+	if (ret)
+		agent_expr_free(cond);
+	return ret;
+}
+
+int target_breakwatch_clear(target *t,
+                            enum target_breakwatch type, target_addr addr, size_t len)
+{
+	struct breakwatch *bwp = NULL, *bw;
+	for (bw = t->bw_list; bw; bwp = bw, bw = bw->next)
+		if (!bw->hook &&
+		    (bw->type == type) &&
+		    (bw->addr == addr) &&
+		    (bw->size == len))
+			break;
+
+	if (bw == NULL)
+		return -1;
+
+	return target_breakwatch_remove(t, bwp, bw);
+}
+
+int target_breakwatch_set_hook(target *t, target_addr addr,
+                               target_breakwatch_hook hook, void *arg)
+{
+	struct breakwatch bw = {
+		.type = TARGET_BREAK_HARD,
+		.addr = addr,
+		.size = 2,
+		.hook = hook,
+		.hook_arg = arg,
+	};
+
+	return target_breakwatch_add(t, &bw);
+}
+
+int target_breakwatch_clear_hook(target *t, target_addr addr, void *arg)
+{
+	struct breakwatch *bwp = NULL, *bw;
+	for (bw = t->bw_list; bw; bwp = bw, bw = bw->next)
+		if (bw->hook && (bw->hook_arg == arg) && (bw->addr == addr))
+			break;
+
+	if (bw == NULL)
+		return -1;
+
+	return target_breakwatch_remove(t, bwp, bw);
+}
+
 /* Accessor functions */
 size_t target_regs_size(target *t)
 {
@@ -493,6 +1018,57 @@ void target_mem_write32(target *t, uint32_t addr, uint32_t value)
 	t->mem_write(t, addr, &value, sizeof(value));
 }
 
+int target_mem_read32_batch(target *t, struct target_mem32 *ops, size_t n)
+{
+	if (t->mem_read32_batch) {
+		t->mem_read32_batch(t, ops, n);
+	} else {
+		for (size_t i = 0; i < n; i++)
+			t->mem_read(t, &ops[i].value, ops[i].addr, sizeof(uint32_t));
+	}
+	return target_check_error(t);
+}
+
+int target_mem_write32_batch(target *t, const struct target_mem32 *ops,
+                             size_t n)
+{
+	if (t->mem_write32_batch) {
+		t->mem_write32_batch(t, ops, n);
+	} else {
+		for (size_t i = 0; i < n; i++)
+			t->mem_write(t, ops[i].addr, &ops[i].value, sizeof(uint32_t));
+	}
+	return target_check_error(t);
+}
+
+int target_mem_poll32(target *t, target_addr addr, uint32_t mask,
+                      uint32_t value, uint32_t timeout_ms, uint32_t *result)
+{
+	uint32_t val = 0;
+	int res = 1;
+	if (t->mem_poll32) {
+		if (t->mem_poll32(t, addr, mask, value, timeout_ms, &val))
+			res = 0;
+		if (target_check_error(t))
+			res = -1;
+	} else {
+		platform_timeout timeout;
+		platform_timeout_set(&timeout, timeout_ms);
+		do {
+			t->mem_read(t, &val, addr, sizeof(val));
+			if (target_check_error(t)) {
+				res = -1;
+				break;
+			}
+			if ((val & mask) == value)
+				res = 0;
+		} while (res && !platform_timeout_is_expired(&timeout));
+	}
+	if (result)
+		*result = val;
+	return res;
+}
+
 uint16_t target_mem_read16(target *t, uint32_t addr)
 {
 	uint16_t ret;
@@ -548,10 +1124,28 @@ void tc_printf(target *t, const char *fmt, ...)
 	va_end(ap);
 }
 
+void tc_console(target *t, const char *buf, size_t len)
+{
+	if ((t->tc == NULL) || (t->tc->console == NULL))
+		return;
+
+	t->tc->console(t->tc, buf, len);
+}
+
 /* Interface to host system calls */
+static bool tc_no_fileio(target *t)
+{
+	if (!t->tc->no_fileio)
+		return false;
+	t->tc->errno_ = TARGET_EBUSY;
+	return true;
+}
+
 int tc_open(target *t, target_addr path, size_t plen,
             enum target_open_flags flags, mode_t mode)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->open == NULL) {
 		t->tc->errno_ = TARGET_ENFILE;
 		return -1;
@@ -561,6 +1155,8 @@ int tc_open(target *t, target_addr path, size_t plen,
 
 int tc_close(target *t, int fd)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->close == NULL) {
 		t->tc->errno_ = TARGET_EBADF;
 		return -1;
@@ -570,6 +1166,8 @@ int tc_close(target *t, int fd)
 
 int tc_read(target *t, int fd, target_addr buf, unsigned int count)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->read == NULL)
 		return 0;
 	return t->tc->read(t->tc, fd, buf, count);
@@ -577,6 +1175,8 @@ int tc_read(target *t, int fd, target_addr buf, unsigned int count)
 
 int tc_write(target *t, int fd, target_addr buf, unsigned int count)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->write == NULL)
 		return 0;
 	return t->tc->write(t->tc, fd, buf, count);
@@ -584,6 +1184,8 @@ int tc_write(target *t, int fd, target_addr buf, unsigned int count)
 
 long tc_lseek(target *t, int fd, long offset, enum target_seek_flag flag)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->lseek == NULL)
 		return 0;
 	return t->tc->lseek(t->tc, fd, offset, flag);
@@ -592,6 +1194,8 @@ long tc_lseek(target *t, int fd, long offset, enum target_seek_flag flag)
 int tc_rename(target *t, target_addr oldpath, size_t oldlen,
                          target_addr newpath, size_t newlen)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->rename == NULL) {
 		t->tc->errno_ = TARGET_ENOENT;
 		return -1;
@@ -601,6 +1205,8 @@ int tc_rename(target *t, target_addr oldpath, size_t oldlen,
 
 int tc_unlink(target *t, target_addr path, size_t plen)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->unlink == NULL) {
 		t->tc->errno_ = TARGET_ENOENT;
 		return -1;
@@ -610,6 +1216,8 @@ int tc_unlink(target *t, target_addr path, size_t plen)
 
 int tc_stat(target *t, target_addr path, size_t plen, target_addr buf)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->stat == NULL) {
 		t->tc->errno_ = TARGET_ENOENT;
 		return -1;
@@ -619,6 +1227,8 @@ int tc_stat(target *t, target_addr path, size_t plen, target_addr buf)
 
 int tc_fstat(target *t, int fd, target_addr buf)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->fstat == NULL) {
 		return 0;
 	}
@@ -627,6 +1237,8 @@ int tc_fstat(target *t, int fd, target_addr buf)
 
 int tc_gettimeofday(target *t, target_addr tv, target_addr tz)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->gettimeofday == NULL) {
 		return -1;
 	}
@@ -635,6 +1247,8 @@ int tc_gettimeofday(target *t, target_addr tv, target_addr tz)
 
 int tc_isatty(target *t, int fd)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->isatty == NULL) {
 		return 1;
 	}
@@ -643,6 +1257,8 @@ int tc_isatty(target *t, int fd)
 
 int tc_system(target *t, target_addr cmd, size_t cmdlen)
 {
+	if (tc_no_fileio(t))
+		return -1;
 	if (t->tc->system == NULL) {
 		return -1;
 	}
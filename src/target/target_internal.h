@@ -48,6 +48,8 @@ struct target_flash {
 	struct target_flash *next;
 	target_addr buf_addr;
 	void *buf;
+	/* Incremental mode: bitmap of blocks with a deferred erase */
+	uint8_t *erase_pending;
 };
 
 typedef bool (*cmd_handler)(target *t, int argc, const char **argv);
@@ -69,9 +71,28 @@ struct breakwatch {
 	enum target_breakwatch type;
 	target_addr addr;
 	size_t size;
+	/* Breakpoint conditions, see target_breakwatch_set_cond() */
+	struct agent_expr *cond;
+	/* See target_breakwatch_set_hook() */
+	target_breakwatch_hook hook;
+	void *hook_arg;
 	uint32_t reserved[4]; /* for use by the implementing driver */
 };
 
+struct agent_expr {
+	struct agent_expr *next;
+	size_t len;
+	uint8_t code[];
+};
+
+/* Address/value pair for batched 32-bit register access */
+struct target_mem32 {
+	target_addr addr;
+	uint32_t value;
+};
+
+struct target_flash_cache;
+
 struct target_s {
 	bool attached;
 	struct target_controller *tc;
@@ -86,6 +107,16 @@ struct target_s {
 	                 size_t len);
 	void (*mem_write)(target *t, target_addr dest,
 	                  const void *src, size_t len);
+	/* Optional batched 32-bit access, see target_mem_write32_batch() */
+	void (*mem_read32_batch)(target *t, struct target_mem32 *ops, size_t n);
+	void (*mem_write32_batch)(target *t, const struct target_mem32 *ops,
+	                          size_t n);
+	/* Optional, see target_mem_poll32() */
+	bool (*mem_poll32)(target *t, target_addr addr, uint32_t mask,
+	                   uint32_t value, uint32_t timeout_ms, uint32_t *result);
+	/* Optional CRC32 computed by the target, see generic_crc32() */
+	bool (*mem_crc32)(target *t, target_addr base, size_t len,
+	                  uint32_t *crc);
 
 	/* Register access functions */
 	size_t regs_size;
@@ -94,6 +125,13 @@ struct target_s {
 	void (*regs_write)(target *t, const void *data);
 	ssize_t (*reg_read)(target *t, int reg, void *data, size_t max);
 	ssize_t (*reg_write)(target *t, int reg, const void *data, size_t size);
+	/* Size of every register in the regs_read() layout if they are all
+	 * the same, 0 otherwise. Allows reg_read() to use the cache. */
+	size_t reg_size;
+	/* Register cache, see target_regs_read() */
+	void *regs_cache;
+	bool regs_cached;
+	bool regs_dirty;
 
 	/* Halt/resume functions */
 	void (*reset)(target *t);
@@ -101,6 +139,8 @@ struct target_s {
 	void (*halt_request)(target *t);
 	enum target_halt_reason (*halt_poll)(target *t, target_addr *watch);
 	void (*halt_resume)(target *t, bool step);
+	/* Set if the last resume was a single step */
+	bool stepping;
 
 	/* Break-/watchpoint functions */
 	int (*breakwatch_set)(target *t, struct breakwatch*);
@@ -114,6 +154,8 @@ struct target_s {
 
 	struct target_ram *ram;
 	struct target_flash *flash;
+	/* Read-only copy of recently read flash pages, see target_mem_read() */
+	struct target_flash_cache *flash_cache;
 
 	/* Other stuff */
 	const char *driver;
@@ -138,10 +180,24 @@ uint8_t target_mem_read8(target *t, uint32_t addr);
 void target_mem_write32(target *t, uint32_t addr, uint32_t value);
 void target_mem_write16(target *t, uint32_t addr, uint16_t value);
 void target_mem_write8(target *t, uint32_t addr, uint8_t value);
+/* Execute a list of 32-bit accesses in order as one queued operation.
+ * Errors are only checked once at the end. */
+int target_mem_read32_batch(target *t, struct target_mem32 *ops, size_t n);
+int target_mem_write32_batch(target *t, const struct target_mem32 *ops,
+                             size_t n);
+/* Read addr until (*addr & mask) == value or timeout_ms expires. Returns
+ * 0 on a match, 1 on timeout and -1 on a communication error. The last
+ * value read is stored in result, if not NULL. */
+int target_mem_poll32(target *t, target_addr addr, uint32_t mask,
+                      uint32_t value, uint32_t timeout_ms, uint32_t *result);
 bool target_check_error(target *t);
+/* Write back cached register writes and drop the cache. Must be called
+ * before driver code accesses the core registers directly. */
+void target_regs_cache_flush(target *t);
 
 /* Access to host controller interface */
 void tc_printf(target *t, const char *fmt, ...);
+void tc_console(target *t, const char *buf, size_t len);
 
 /* Interface to host system calls */
 int tc_open(target *, target_addr path, size_t plen,